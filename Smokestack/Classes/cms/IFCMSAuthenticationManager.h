@@ -21,8 +21,10 @@
 #import "IFHTTPClient.h"
 
 /// A class for managing HTTP authentication on CMS server requests.
-@interface IFCMSAuthenticationManager : NSObject <NSURLSessionTaskDelegate> {
+@interface IFCMSAuthenticationManager : NSObject <NSURLSessionTaskDelegate, IFHTTPClientAuthorizationProvider> {
     NSURLProtectionSpace *_protectionSpace;
+    /// The active user's Basic auth header, cached in memory; nil if not yet read.
+    NSString *_basicAuthHeader;
 }
 
 /// Initialize an authentication manager for the named authentication realm.
@@ -23,7 +23,10 @@
 
 @interface IFCMSAuthenticationManager()
 
-//- (NSString *)basicAuthHeader;
+/// Return a Basic auth header for the active user's credentials, or nil if no active user.
+- (NSString *)basicAuthHeader;
+/// Test whether a URL belongs to the manager's protection space.
+- (BOOL)isURLInProtectionSpace:(NSURL *)url;
 - (NSURLCredential *)getCredentialForUsername:(NSString *)username;
 - (NSString *)getActiveUsername;
 - (void)unsetActiveUser;
@@ -85,6 +88,10 @@
         // Record that we have credentials
         NSString *key = [self getUserDefaultsKey:@"activeUsername"];
         [[NSUserDefaults standardUserDefaults] setObject:username forKey:key];
+        // Invalidate any cached auth header.
+        @synchronized (self) {
+            _basicAuthHeader = nil;
+        }
     }
 }
 
@@ -94,6 +101,10 @@
 }
 
 - (void)removeCredentials {
+    // Invalidate any cached auth header.
+    @synchronized (self) {
+        _basicAuthHeader = nil;
+    }
     NSURLCredential *credential = nil;
     NSURLCredentialStorage *storage = [NSURLCredentialStorage sharedCredentialStorage];
     // Check for an active user.
@@ -120,6 +131,35 @@
     }
 }
 
+- (NSString *)basicAuthHeader {
+    @synchronized (self) {
+        if (!_basicAuthHeader) {
+            NSString *username = [self getActiveUsername];
+            NSURLCredential *credential = username ? [self getCredentialForUsername:username] : nil;
+            if (credential) {
+                NSString *userpass = [NSString stringWithFormat:@"%@:%@", credential.user, credential.password];
+                NSData *data = [userpass dataUsingEncoding:NSUTF8StringEncoding];
+                _basicAuthHeader = [@"Basic " stringByAppendingString:[data base64EncodedStringWithOptions:0]];
+            }
+        }
+        return _basicAuthHeader;
+    }
+}
+
+- (BOOL)isURLInProtectionSpace:(NSURL *)url {
+    if (![_protectionSpace.host isEqualToString:url.host]) {
+        return NO;
+    }
+    if ([_protectionSpace.protocol caseInsensitiveCompare:url.scheme] != NSOrderedSame) {
+        return NO;
+    }
+    NSInteger port = [url.port integerValue];
+    if (!url.port) {
+        port = [@"https" isEqualToString:[url.scheme lowercaseString]] ? 443 : 80;
+    }
+    return _protectionSpace.port == 0 || _protectionSpace.port == port;
+}
+
 - (NSURLCredential *)getCredentialForUsername:(NSString *)username {
     NSURLCredentialStorage *storage = [NSURLCredentialStorage sharedCredentialStorage];
     NSDictionary *credentials = [storage credentialsForProtectionSpace:_protectionSpace];
@@ -152,6 +192,15 @@
     return [NSString stringWithFormat:@"%@.%016lX.%@", prefix, (unsigned long)[pspace hash], keyName];
 }
 
+#pragma mark - IFHTTPClientAuthorizationProvider
+
+- (NSString *)authorizationHeaderForURL:(NSURL *)url {
+    if ([self isURLInProtectionSpace:url]) {
+        return [self basicAuthHeader];
+    }
+    return nil;
+}
+
 #pragma mark - NSURLSessionTaskDelegate
 
 - (void)URLSession:(NSURLSession *)session
@@ -0,0 +1,77 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * A content-addressed store of cached file contents.
+ * Each distinct file content is stored once, as a blob named by its SHA-256 hash, and is hard
+ * linked into each fileset cache location where it is used; identical files appearing in several
+ * filesets or cache roots therefore share a single copy on disk. The blob store must be on the same
+ * volume as the fileset cache directories.
+ * The hard links double as blob reference counts: a blob whose link count has dropped to one is
+ * only referenced by the store, and can be purged.
+ */
+@interface IFCMSBlobStore : NSObject {
+    /// A serial queue used to purge unreferenced blobs.
+    dispatch_queue_t _purgeQueue;
+    /// A lock serializing blob link changes with purges, so that a blob isn't purged while being linked.
+    NSLock *_linkLock;
+}
+
+/// Initialize the store using the directory at the specified path.
+- (id)initWithPath:(NSString *)path;
+
+/// The path to the store's directory.
+@property (nonatomic, strong, readonly) NSString *path;
+
+/// Return the path of the blob with the specified hash.
+- (NSString *)pathForBlob:(NSString *)hash;
+/// Test whether a blob with the specified hash is in the store.
+- (BOOL)hasBlob:(NSString *)hash;
+/**
+ * Add the file at the specified path to the store.
+ * If a blob with the same content is already in the store then the file is replaced with a link to
+ * that blob; otherwise the file becomes a new blob. Returns the file's hash, or nil if the file
+ * can't be added.
+ */
+- (NSString *)addFileAtPath:(NSString *)path;
+/// Link the blob with the specified hash to a path, replacing any file already at that path.
+- (BOOL)linkBlob:(NSString *)hash toPath:(NSString *)path;
+/**
+ * Add all files under a fileset directory to the store.
+ * The manifest describes the directory's files when last added, as a map of relative file paths
+ * to manifest entries; files whose size and modification time are unchanged since then are linked
+ * to their recorded blob without being hashed again. Returns the directory's new manifest.
+ * Manifest entries are dictionaries with 'path', 'hash', 'size' and 'mtime' values.
+ */
+- (NSDictionary *)addDirectoryAtPath:(NSString *)path manifest:(NSDictionary *)manifest;
+/// Return a manifest entry for the file at the specified path, or nil if the file doesn't exist.
+- (NSDictionary *)manifestEntryForFileAtPath:(NSString *)path hash:(NSString *)hash;
+/**
+ * Delete blobs no longer linked to any fileset location. The purge is performed on a background queue.
+ * Each blob is checked and deleted while holding the store's link lock, so a blob being linked by a
+ * concurrent add or link is never deleted.
+ */
+- (void)purgeUnreferencedBlobs;
+
+/// Return the hex encoded SHA-256 hash of the file at the specified path.
++ (NSString *)hashOfFileAtPath:(NSString *)path;
+
+@end
@@ -0,0 +1,227 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import "IFCMSBlobStore.h"
+#import <CommonCrypto/CommonDigest.h>
+#import <sys/stat.h>
+#import <unistd.h>
+#import <stdio.h>
+
+/// The number of bytes hashed per iteration when hashing a file.
+#define HashChunkSize (1024 * 1024)
+
+@interface IFCMSBlobStore ()
+
+/// Replace the file at a path with a hard link to a blob, via a temporary link and a rename.
+- (BOOL)replaceFileAtPath:(NSString *)path withBlobAtPath:(NSString *)blobPath;
+
+@end
+
+/// Return the modification time of a stat record, in nanoseconds.
+static long long mtimeNanos(struct stat *st) {
+    return (long long)st->st_mtimespec.tv_sec * 1000000000LL + st->st_mtimespec.tv_nsec;
+}
+
+@implementation IFCMSBlobStore
+
+- (id)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        _path = path;
+        _purgeQueue = dispatch_queue_create("IFCMSBlobStore.purge", DISPATCH_QUEUE_SERIAL);
+        _linkLock = [NSLock new];
+        [[NSFileManager defaultManager] createDirectoryAtPath:path
+                                  withIntermediateDirectories:YES
+                                                   attributes:nil
+                                                        error:nil];
+    }
+    return self;
+}
+
+- (NSString *)pathForBlob:(NSString *)hash {
+    // Blobs are sharded by the first two characters of their hash, to keep directory sizes small.
+    NSString *shard = [hash length] > 2 ? [hash substringToIndex:2] : @"00";
+    return [[_path stringByAppendingPathComponent:shard] stringByAppendingPathComponent:hash];
+}
+
+- (BOOL)hasBlob:(NSString *)hash {
+    return hash && [[NSFileManager defaultManager] fileExistsAtPath:[self pathForBlob:hash]];
+}
+
+- (NSString *)addFileAtPath:(NSString *)path {
+    NSString *hash = [IFCMSBlobStore hashOfFileAtPath:path];
+    if (!hash) {
+        return nil;
+    }
+    NSString *blobPath = [self pathForBlob:hash];
+    [[NSFileManager defaultManager] createDirectoryAtPath:[blobPath stringByDeletingLastPathComponent]
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+    // Link the file into the store as a new blob. The blob is created with a link count of two, so
+    // a later purge doesn't see it as unreferenced. The lock stops a purge deleting an existing blob
+    // between the failed link and its replacement of the file.
+    BOOL ok = NO;
+    [_linkLock lock];
+    if (link([path fileSystemRepresentation], [blobPath fileSystemRepresentation]) == 0) {
+        ok = YES;
+    }
+    else if (errno == EEXIST) {
+        // Blob already in the store; replace the file with a link to it.
+        struct stat fileStat, blobStat;
+        if (stat([path fileSystemRepresentation], &fileStat) == 0
+            && stat([blobPath fileSystemRepresentation], &blobStat) == 0
+            && fileStat.st_ino == blobStat.st_ino) {
+            // File is already linked to the blob.
+            ok = YES;
+        }
+        else {
+            ok = [self replaceFileAtPath:path withBlobAtPath:blobPath];
+        }
+    }
+    [_linkLock unlock];
+    return ok ? hash : nil;
+}
+
+- (BOOL)linkBlob:(NSString *)hash toPath:(NSString *)path {
+    NSString *blobPath = [self pathForBlob:hash];
+    [[NSFileManager defaultManager] createDirectoryAtPath:[path stringByDeletingLastPathComponent]
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+    // Fails if the blob has been purged since the caller checked for it.
+    [_linkLock lock];
+    BOOL ok = [self replaceFileAtPath:path withBlobAtPath:blobPath];
+    [_linkLock unlock];
+    return ok;
+}
+
+- (NSDictionary *)addDirectoryAtPath:(NSString *)path manifest:(NSDictionary *)manifest {
+    NSMutableDictionary *result = [NSMutableDictionary new];
+    NSDirectoryEnumerator *files = [[NSFileManager defaultManager] enumeratorAtPath:path];
+    for (NSString *relPath in files) {
+        if (![NSFileTypeRegular isEqualToString:files.fileAttributes[NSFileType]]) {
+            continue;
+        }
+        NSString *filePath = [path stringByAppendingPathComponent:relPath];
+        struct stat st;
+        if (stat([filePath fileSystemRepresentation], &st) != 0) {
+            continue;
+        }
+        NSString *hash = nil;
+        // If the file is unchanged since it was last added then link it to its recorded blob; the
+        // file may be an unlinked copy, e.g. after the fileset directory was cloned for staging.
+        NSDictionary *entry = manifest[relPath];
+        BOOL linked = NO;
+        if (entry
+            && [entry[@"size"] longLongValue] == (long long)st.st_size
+            && [entry[@"mtime"] longLongValue] == mtimeNanos(&st)) {
+            [_linkLock lock];
+            linked = [self hasBlob:entry[@"hash"]]
+                  && [self replaceFileAtPath:filePath withBlobAtPath:[self pathForBlob:entry[@"hash"]]];
+            [_linkLock unlock];
+        }
+        if (linked) {
+            hash = entry[@"hash"];
+        }
+        else {
+            hash = [self addFileAtPath:filePath];
+        }
+        entry = hash ? [self manifestEntryForFileAtPath:filePath hash:hash] : nil;
+        if (entry) {
+            NSMutableDictionary *mentry = [entry mutableCopy];
+            mentry[@"path"] = relPath;
+            result[relPath] = mentry;
+        }
+    }
+    return result;
+}
+
+- (NSDictionary *)manifestEntryForFileAtPath:(NSString *)path hash:(NSString *)hash {
+    struct stat st;
+    if (stat([path fileSystemRepresentation], &st) != 0) {
+        return nil;
+    }
+    return @{
+        @"path":    path,
+        @"hash":    hash,
+        @"size":    [NSNumber numberWithLongLong:(long long)st.st_size],
+        @"mtime":   [NSNumber numberWithLongLong:mtimeNanos(&st)]
+    };
+}
+
+- (void)purgeUnreferencedBlobs {
+    NSString *path = _path;
+    NSLock *linkLock = _linkLock;
+    dispatch_async(_purgeQueue, ^{
+        NSFileManager *fileManager = [NSFileManager new];
+        for (NSString *shard in [fileManager contentsOfDirectoryAtPath:path error:nil]) {
+            NSString *shardPath = [path stringByAppendingPathComponent:shard];
+            for (NSString *name in [fileManager contentsOfDirectoryAtPath:shardPath error:nil]) {
+                NSString *blobPath = [shardPath stringByAppendingPathComponent:name];
+                // The lock is taken per blob, so that adds and links are only briefly blocked.
+                [linkLock lock];
+                struct stat st;
+                if (stat([blobPath fileSystemRepresentation], &st) == 0 && S_ISREG(st.st_mode) && st.st_nlink <= 1) {
+                    unlink([blobPath fileSystemRepresentation]);
+                }
+                [linkLock unlock];
+            }
+        }
+    });
+}
+
++ (NSString *)hashOfFileAtPath:(NSString *)path {
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    if (!data) {
+        return nil;
+    }
+    CC_SHA256_CTX ctx;
+    CC_SHA256_Init(&ctx);
+    const uint8_t *bytes = (const uint8_t *)[data bytes];
+    NSUInteger length = [data length];
+    for (NSUInteger offset = 0; offset < length; offset += HashChunkSize) {
+        CC_SHA256_Update(&ctx, bytes + offset, (CC_LONG)MIN((NSUInteger)HashChunkSize, length - offset));
+    }
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &ctx);
+    NSMutableString *hash = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    for (NSInteger i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+        [hash appendFormat:@"%02x", digest[i]];
+    }
+    return hash;
+}
+
+#pragma mark - Private
+
+- (BOOL)replaceFileAtPath:(NSString *)path withBlobAtPath:(NSString *)blobPath {
+    // Create the link under a temporary name and then rename it over the file, so that the file is
+    // never missing.
+    NSString *tmpPath = [path stringByAppendingFormat:@".%@.link", [[NSUUID UUID] UUIDString]];
+    if (link([blobPath fileSystemRepresentation], [tmpPath fileSystemRepresentation]) != 0) {
+        return NO;
+    }
+    if (rename([tmpPath fileSystemRepresentation], [path fileSystemRepresentation]) != 0) {
+        unlink([tmpPath fileSystemRepresentation]);
+        return NO;
+    }
+    return YES;
+}
+
+@end
@@ -0,0 +1,61 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import <Foundation/Foundation.h>
+#import "IFCMSFileDB.h"
+
+/**
+ * A manager of the size of the content cache.
+ * Records the size and last access time of each file cached for an evictable fileset (i.e. a
+ * fileset using the content cache, and which isn't pinned) in the file DB's cache_entries table.
+ * When the total size of the cached files exceeds the cache budget, the least recently used files
+ * are deleted from the cache until the total size is reduced to below the budget, and their cache
+ * entries are marked as evicted; evicted files are downloaded again on demand when next requested.
+ * All DB access and evictions are performed on a private background queue, using a dedicated
+ * instance of the file DB.
+ */
+@interface IFCMSCacheManager : NSObject {
+    /// The file DB instance used by the manager.
+    IFCMSFileDB *_fileDB;
+    /// A serial queue used to record cache entries and evict files.
+    dispatch_queue_t _queue;
+    /// File access times recorded since the last flush, keyed by file path.
+    NSMutableDictionary *_pendingAccesses;
+    /// Flag indicating whether a flush of pending access times is scheduled.
+    BOOL _flushScheduled;
+}
+
+/// Initialize the manager using a new instance of the specified file DB.
+- (id)initWithFileDB:(IFCMSFileDB *)fileDB;
+
+/// The maximum total size of evictable cached files, in bytes. Zero for no limit.
+@property (nonatomic, assign) unsigned long long budget;
+
+/// Test whether a fileset category's cached files can be evicted.
+- (BOOL)isEvictableFileset:(NSString *)category;
+/// Record an access to a cached file.
+- (void)recordAccessToFile:(NSDictionary *)fileRecord;
+/// Record that a file has been added to the cache at the specified location; clears any evicted mark.
+- (void)addFile:(NSDictionary *)fileRecord atPath:(NSString *)path;
+/// Record the files in a newly deployed fileset cache directory; clears any evicted marks.
+- (void)addFileset:(NSString *)category atPath:(NSString *)path;
+/// Evict least recently used files if the cache is over budget.
+- (void)evictIfNeeded;
+
+@end
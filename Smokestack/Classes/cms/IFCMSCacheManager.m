@@ -0,0 +1,192 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import "IFCMSCacheManager.h"
+#import "IFCMSFileset.h"
+#import "IFLogger.h"
+
+static IFLogger *Logger;
+
+/// The delay before recorded file access times are written to the DB, in seconds.
+#define AccessFlushDelay    (5.0)
+/// The fraction of the budget that the cache is reduced to when evicting, so that evictions aren't needed on every add.
+#define EvictionTargetRatio (0.9)
+/// The number of cache entries read per eviction query.
+#define EvictionBatchSize   (100)
+
+@interface IFCMSCacheManager ()
+
+/// Write pending file access times to the DB. Must be called on the manager's queue.
+- (void)flushAccesses;
+/// Evict files if over budget. Must be called on the manager's queue.
+- (void)evict;
+
+@end
+
+@implementation IFCMSCacheManager
+
++ (void)initialize {
+    Logger = [[IFLogger alloc] initWithTag:@"IFCMSCacheManager"];
+}
+
+- (id)initWithFileDB:(IFCMSFileDB *)fileDB {
+    self = [super init];
+    if (self) {
+        _fileDB = [fileDB newInstance];
+        _queue = dispatch_queue_create("IFCMSCacheManager", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(_queue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        _pendingAccesses = [NSMutableDictionary new];
+    }
+    return self;
+}
+
+- (BOOL)isEvictableFileset:(NSString *)category {
+    IFCMSFileset *fileset = _fileDB.filesets[category];
+    return fileset && [@"content" isEqualToString:fileset.cache] && !fileset.pinned;
+}
+
+- (void)recordAccessToFile:(NSDictionary *)fileRecord {
+    NSString *path = fileRecord[@"path"];
+    if (!path || ![self isEvictableFileset:fileRecord[@"category"]]) {
+        return;
+    }
+    NSNumber *now = [NSNumber numberWithDouble:[[NSDate date] timeIntervalSince1970]];
+    dispatch_async(_queue, ^{
+        _pendingAccesses[path] = now;
+        // Access times are written in batches, to avoid a DB write for every file read.
+        if (!_flushScheduled) {
+            _flushScheduled = YES;
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(AccessFlushDelay * NSEC_PER_SEC)), _queue, ^{
+                [self flushAccesses];
+            });
+        }
+    });
+}
+
+- (void)addFile:(NSDictionary *)fileRecord atPath:(NSString *)path {
+    NSString *filePath = fileRecord[@"path"];
+    NSString *category = fileRecord[@"category"];
+    if (!filePath || ![self isEvictableFileset:category]) {
+        return;
+    }
+    dispatch_async(_queue, ^{
+        NSDictionary *attributes = [[NSFileManager new] attributesOfItemAtPath:path error:nil];
+        NSNumber *size = [NSNumber numberWithUnsignedLongLong:[attributes fileSize]];
+        NSNumber *now = [NSNumber numberWithDouble:[[NSDate date] timeIntervalSince1970]];
+        [_fileDB performUpdate:@"INSERT OR REPLACE INTO cache_entries (path, category, size, accessed, evicted) VALUES (?, ?, ?, ?, 0)"
+                    withParams:@[ filePath, category, size, now ]];
+        [self evict];
+    });
+}
+
+- (void)addFileset:(NSString *)category atPath:(NSString *)path {
+    if (![self isEvictableFileset:category]) {
+        return;
+    }
+    dispatch_async(_queue, ^{
+        NSNumber *now = [NSNumber numberWithDouble:[[NSDate date] timeIntervalSince1970]];
+        [_fileDB beginTransaction];
+        NSDirectoryEnumerator *files = [[NSFileManager new] enumeratorAtPath:path];
+        for (NSString *filePath in files) {
+            NSDictionary *attributes = files.fileAttributes;
+            if (![NSFileTypeRegular isEqualToString:attributes[NSFileType]]) {
+                continue;
+            }
+            NSNumber *size = [NSNumber numberWithUnsignedLongLong:[attributes fileSize]];
+            // New files are recorded as accessed at deploy time; existing files keep their access time
+            // (cache entry paths are unique, so the insert is ignored for existing files).
+            [_fileDB performUpdate:@"INSERT OR IGNORE INTO cache_entries (path, category, size, accessed, evicted) VALUES (?, ?, ?, ?, 0)"
+                        withParams:@[ filePath, category, size, now ]];
+            [_fileDB performUpdate:@"UPDATE cache_entries SET size=?, evicted=0 WHERE path=?"
+                        withParams:@[ size, filePath ]];
+        }
+        // Remove entries for files which no longer exist.
+        [_fileDB performUpdate:@"DELETE FROM cache_entries WHERE category=? AND path NOT IN (SELECT path FROM files)"
+                    withParams:@[ category ]];
+        [_fileDB commitTransaction];
+        [self evict];
+    });
+}
+
+- (void)evictIfNeeded {
+    dispatch_async(_queue, ^{
+        [self evict];
+    });
+}
+
+#pragma mark - Private
+
+- (void)flushAccesses {
+    _flushScheduled = NO;
+    if ([_pendingAccesses count] == 0) {
+        return;
+    }
+    [_fileDB beginTransaction];
+    for (NSString *path in _pendingAccesses) {
+        [_fileDB performUpdate:@"UPDATE cache_entries SET accessed=? WHERE path=?"
+                    withParams:@[ _pendingAccesses[path], path ]];
+    }
+    [_fileDB commitTransaction];
+    [_pendingAccesses removeAllObjects];
+}
+
+- (void)evict {
+    if (_budget == 0) {
+        return;
+    }
+    NSArray *rs = [_fileDB performQuery:@"SELECT SUM(size) AS total FROM cache_entries WHERE evicted=0" withParams:@[]];
+    unsigned long long total = [rs count] > 0 ? [rs[0][@"total"] unsignedLongLongValue] : 0;
+    if (total <= _budget) {
+        return;
+    }
+    // Write pending access times first, so that recently used files aren't evicted.
+    [self flushAccesses];
+    unsigned long long target = (unsigned long long)(_budget * EvictionTargetRatio);
+    NSFileManager *fileManager = [NSFileManager new];
+    NSString *sql = [NSString stringWithFormat:@"SELECT path, category, size FROM cache_entries WHERE evicted=0 ORDER BY accessed LIMIT %d", EvictionBatchSize];
+    NSInteger evicted = 0;
+    while (total > target) {
+        NSArray *entries = [_fileDB performQuery:sql withParams:@[]];
+        if ([entries count] == 0) {
+            break;
+        }
+        [_fileDB beginTransaction];
+        for (NSDictionary *entry in entries) {
+            if (total <= target) {
+                break;
+            }
+            // Delete the file from its fileset directory, and drop its manifest entry so that the
+            // file is no longer resolved to a blob. Note that a blob shared with other filesets is
+            // only deleted once none of them link to it.
+            NSString *location = [_fileDB filesetLocationForFile:entry];
+            if (location) {
+                [fileManager removeItemAtPath:location error:nil];
+            }
+            [_fileDB performUpdate:@"DELETE FROM manifest WHERE path=?" withParams:@[ entry[@"path"] ]];
+            [_fileDB performUpdate:@"UPDATE cache_entries SET evicted=1 WHERE path=?" withParams:@[ entry[@"path"] ]];
+            total -= MIN(total, [entry[@"size"] unsignedLongLongValue]);
+            evicted++;
+        }
+        [_fileDB commitTransaction];
+    }
+    [_fileDB.blobStore purgeUnreferencedBlobs];
+    [Logger info:@"Evicted %ld files from the content cache", (long)evicted];
+}
+
+@end
@@ -23,6 +23,7 @@
 #import "IFCMSSettings.h"
 #import "IFCMSFileDB.h"
 #import "IFHTTPClient.h"
+#import "IFCMSPathIndex.h"
 
 @class IFCMSContentAuthority;
 
@@ -40,5 +41,51 @@
 @property (nonatomic, strong) IFCMSFileDB *fileDB;
 /** An HTTP client instance. */
 @property (nonatomic, weak) IFHTTPClient *httpClient;
+/** The file path index; reloaded after each refresh which modifies file records. */
+@property (nonatomic, weak) IFCMSPathIndex *pathIndex;
+/**
+ * Flag indicating whether to stream refresh updates.
+ * When YES, update records are applied to the file DB as they are received from the server,
+ * instead of after the full response has been downloaded and parsed.
+ */
+@property (nonatomic, assign) BOOL streamUpdates;
+/**
+ * Flag indicating whether to stream fileset downloads.
+ * When YES, fileset zips are extracted into a staged copy of the fileset as they are downloaded;
+ * otherwise, the zip is downloaded (resumably) to a file before being extracted into the staged
+ * copy. In both cases the staged copy is then swapped into the fileset's cache location atomically.
+ */
+@property (nonatomic, assign) BOOL streamFilesets;
+/**
+ * The number of update records to apply per DB transaction during a refresh.
+ * When greater than zero, the refresh commits its updates in chunks of this size and records
+ * a checkpoint after each chunk; an interrupted refresh is then resumed from the checkpoint
+ * by the next refresh command. When zero, all updates are applied in a single transaction.
+ */
+@property (nonatomic, assign) NSInteger chunkSize;
+/// The Accept-Encoding header value sent with refresh and fileset requests.
+@property (nonatomic, strong) NSString *acceptEncodings;
+/**
+ * The maximum number of changed files in an updated fileset to download individually.
+ * Changed files are those whose content hash in the files table doesn't match the hash recorded
+ * in the blob store manifest; when there are no more than this number then a sync-files command
+ * is queued for the fileset, instead of a fileset zip download. Zero disables file syncs.
+ */
+@property (nonatomic, assign) NSInteger fileSyncLimit;
+/**
+ * The maximum number of files referenced by updated posts to prefetch after a refresh.
+ * Prefetches are queued as low priority prefetch-file commands in the 'prefetch' lane, so that
+ * they run one at a time after the refresh's fileset downloads. Zero disables prefetching.
+ */
+@property (nonatomic, assign) NSInteger prefetchLimit;
+/**
+ * Flag indicating whether to download updated filesets in a single batch request.
+ * When YES, the zip downloads for a refresh's updated filesets are made by a single
+ * download-filesets command, which requests a combined archive of the filesets and then splits
+ * it into per-fileset staging directories. If the server doesn't support batch requests then
+ * download-fileset commands are queued for each fileset instead, and batching is disabled for
+ * the rest of the session.
+ */
+@property (nonatomic, assign) BOOL batchFilesets;
 
 @end
@@ -17,25 +17,341 @@
 //
 
 #import "IFCMSCommandProtocol.h"
-#import "IFFileIO.h"
 #import "IFCMSFileset.h"
 #import "IFCMSContentAuthority.h"
 #import "IFContentProvider.h"
 #import "IFAppContainer.h"
+#import "IFStreamDataReader.h"
+#import "IFZipStreamExtractor.h"
+#import "IFZipExtractor.h"
+#import "IFCMSMerkleTree.h"
+#import <stdio.h>
+#import <sys/clonefile.h>
+#import "IFCommandScheduler.h"
 
 #define URLEncode(s)    ([s stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet URLHostAllowedCharacterSet]])
 #define IsSecure        ([_authManager hasCredentials] ? @"true" : @"false")
 #define AcceptMIMETypes (@"application/msgpack, application/json;q=0.9, */*;q=0.8")
-#define AcceptEncodings (@"gzip")
+#define RefreshCheckpointID (@"refresh")
+#define TombstoneBatchSize  (100)
+#define FileSyncBatchSize   (50)
+#define MaxSyncDirectoryFilter  (200)
+#define PrefetchPriority    (2)
+#define MaxQueryParams      (500)
 
-@interface IFCMSCommandProtocol ()
+/// A receiver for streamed refresh responses; applies update records to the file DB as they arrive.
+@interface IFCMSRefreshStream : NSObject <IFHTTPClientDataReceiver> {
+    __weak IFCMSCommandProtocol *_protocol;
+    IFCMSFileDB *_fileDB;
+    IFStreamDataReader *_reader;
+    NSMutableData *_buffer;
+    NSError *_error;
+    BOOL _updating;
+}
+
+- (id)initWithCommandProtocol:(IFCMSCommandProtocol *)protocol;
+
+/// Flag indicating whether the response data is being streamed.
+@property (nonatomic, readonly) BOOL streamed;
+/// The response data, when the response isn't streamed.
+@property (nonatomic, readonly) NSData *bufferedData;
+/// The response data, excluding streamed update records.
+@property (nonatomic, readonly) id result;
+/// The ACM group fingerprint reported by the server.
+@property (nonatomic, strong, readonly) NSString *group;
+
+/// Apply an update record to the file DB.
+- (void)applyUpdate:(id)values toTable:(NSString *)tableName;
+/// Start the updates transaction, if not already started.
+- (void)beginUpdates;
+/// Finish reading the response. Returns NO if the response data couldn't be read.
+- (BOOL)finish:(NSError **)error;
+/// Abort the refresh, rolling back any updates already applied.
+- (void)abort;
+
+@end
+
+@interface IFCMSCommandProtocol () {
+    /// Flag indicating that the server doesn't support batch fileset requests.
+    BOOL _batchFilesetsUnsupported;
+    /// A serial queue for staging, extracting and publishing fileset updates.
+    dispatch_queue_t _deployQueue;
+    /// The commit ID the current refresh is fetching updates since (may be nil).
+    NSString *_refreshCommit;
+    /// The ACM group fingerprint the current refresh is fetching updates for (may be nil).
+    NSString *_refreshGroup;
+    /// A map of fileset category names to a 'since' commit value (may be null), for the current refresh.
+    NSMutableDictionary *_updatedCategories;
+    /// Flag indicating that the current refresh is resuming from a checkpoint.
+    BOOL _resuming;
+    /// Flag indicating that the current refresh is known to be migrating to a new ACM group.
+    BOOL _migrating;
+    /// Flag indicating that the current refresh has modified file records.
+    BOOL _filesChanged;
+    /// The number of update records applied in the current transaction.
+    NSInteger _chunkRowCount;
+    /// The number of update records written or deleted by the current refresh, including any written
+    /// before a resumed refresh was interrupted; records skipped as already applied aren't counted.
+    NSInteger _appliedRowCount;
+}
 
 /// Start a content refresh.
 - (QPromise *)refresh:(NSArray *)args;
+/**
+ * Complete the current refresh, resolving its promise with a list of follow up commands.
+ * Reports the refresh result to the authority, together with any next check hint from the server,
+ * so that the next refresh can be scheduled.
+ */
+- (void)finishRefresh:(NSArray *)commands response:(IFHTTPClientResponse *)response hint:(id)hint;
+/// Fail the current refresh, rejecting its promise.
+- (void)failRefresh:(NSString *)message;
+/**
+ * Return the number of seconds until the next refresh suggested by the server, or zero if none.
+ * Reads a Retry-After response header, or a next check value (in seconds) in the response data.
+ */
+- (NSTimeInterval)nextCheckForResponse:(IFHTTPClientResponse *)response hint:(id)hint;
 /// Update the file db and fileset schema.
 //- (QPromise *)updateSchema:(NSArray *)args;
 /// Download a fileset.
 - (QPromise *)downloadFileset:(NSArray *)args;
+/**
+ * Download the changed files in a fileset individually.
+ * Downloads a batch of the fileset's files whose content hash doesn't match the blob store
+ * manifest, linking to existing blobs where possible. Returns a follow up command to sync the
+ * next batch, if any changed files remain; the fileset's fingerprint is updated once all files
+ * have been synced.
+ */
+- (QPromise *)syncFiles:(NSArray *)args;
+/**
+ * Return the files in a fileset which need to be synced; i.e. files whose content hash doesn't
+ * match the blob store manifest. Returns nil if the fileset's files can't be synced individually,
+ * e.g. because some files don't have a content hash.
+ */
+- (NSArray *)filesToSyncInFileset:(NSString *)category limit:(NSInteger)limit;
+/**
+ * Return the expected directory tree for a fileset.
+ * Uses the tree sent by the server in the merkle table, if any; otherwise calculates the tree from
+ * the content hashes in the files table. Returns nil if the tree can't be calculated.
+ */
+- (IFCMSMerkleTree *)expectedTreeForFileset:(NSString *)category;
+/// Return the directory tree of the cached copy of a fileset, or nil if not known.
+- (IFCMSMerkleTree *)localTreeForFileset:(NSString *)category;
+/// Recalculate the directory tree of the cached copy of a fileset from its blob store manifest.
+- (void)updateLocalTreeForFileset:(NSString *)category;
+/**
+ * Return prefetch-file commands for uncached files referenced by posts received in the current
+ * refresh. Commands are ordered by post recency, most recent first.
+ */
+- (NSArray *)prefetchCommands;
+/// Return the file paths referenced by links in a post body; relative links are resolved against the post's path.
+- (NSArray *)filePathsReferencedByBody:(NSString *)body postPath:(NSString *)postPath;
+/// Download a file into the cache, if not already cached.
+- (QPromise *)prefetchFile:(NSArray *)args;
+/**
+ * Download several filesets in a single request.
+ * Each argument is a list of download-fileset arguments, i.e. [category, cacheLocation, since?].
+ * The server returns a combined archive with each fileset's files under a top-level directory
+ * named after its category; the archive is extracted and each fileset is then staged and
+ * published separately. Returns download-fileset commands for any filesets not in the archive,
+ * or for all filesets if the server doesn't support batch requests.
+ */
+- (QPromise *)downloadFilesets:(NSArray *)args;
+/**
+ * Deploy filesets from a batch download archive. Filesets missing from the archive are downloaded
+ * separately, by follow-on commands. Must be called on the deploy queue.
+ */
+- (void)deployFilesets:(NSArray *)args
+           fromArchive:(NSString *)downloadPath
+             batchName:(NSString *)batchName
+             manifests:(NSDictionary *)manifests
+              response:(IFHTTPClientResponse *)response
+               promise:(QPromise *)promise;
+/// Return a download-fileset command for each of a list of download-fileset argument lists.
+- (NSArray *)filesetDownloadCommands:(NSArray *)argsList;
+/// Move the files under one directory into another directory, replacing any existing files.
+- (BOOL)mergeDirectory:(NSString *)fromPath intoPath:(NSString *)toPath;
+/// Update a fileset's fingerprint after a successful download. Must be called on the command execution queue.
+- (void)completeFilesetDownload:(NSString *)category response:(IFHTTPClientResponse *)response;
+/**
+ * Move a downloaded file into the staging directory, so that it's still available once the download
+ * promise has resolved (e.g. for extraction on the deploy queue). Returns the file's new path, or nil
+ * if the file can't be moved.
+ */
+- (NSString *)keepDownloadedFile:(IFHTTPClientResponse *)response withName:(NSString *)name;
+/**
+ * Create a staging directory for deploying a fileset update.
+ * The staging directory starts as a copy of the fileset's current cache directory (fileset zips may
+ * only contain files changed since the last download). The directory is cloned where the OS and file
+ * system support it, and is otherwise copied file by file. Returns nil if the staging directory can't
+ * be created. Must be called on the deploy queue.
+ */
+- (NSString *)stageFileset:(NSString *)category fromPath:(NSString *)cachePath;
+/**
+ * Publish a staged fileset to its cache location.
+ * The staged directory is swapped with the current cache directory in a single atomic rename, so
+ * that readers see either the complete old or the complete new fileset; the old directory is then
+ * retired. If files are deduplicated then the staged files are first added to the blob store, using
+ * the fileset's previous manifest. Doesn't access the file DB; returns the fileset's new manifest
+ * (empty if files aren't deduplicated), to be recorded using recordPublishedFileset:, or nil if the
+ * fileset couldn't be published. Must be called on the deploy queue.
+ */
+- (NSDictionary *)publishStagedFileset:(NSString *)stagedPath
+                              category:(NSString *)category
+                                toPath:(NSString *)cachePath
+                      previousManifest:(NSDictionary *)previousManifest;
+/**
+ * Record a published fileset's manifest and directory tree in the file DB, and add its files to the
+ * content cache. Must be called on the command execution queue.
+ */
+- (void)recordPublishedFileset:(NSString *)category atPath:(NSString *)cachePath manifest:(NSDictionary *)manifest;
+/// Move a directory out of the way and delete it on a background queue.
+- (void)retireFilesetDirectory:(NSString *)path;
+/// Delete any retired directories left over from a previous run, e.g. if the app was terminated mid-delete.
+- (void)purgeRetiredFilesetDirectories;
+/**
+ * Delete a batch of obsolete cached files recorded in the tombstones table.
+ * Returns a follow up command to delete the next batch, if any tombstones remain.
+ */
+- (QPromise *)purgeDeletedFiles:(NSArray *)args;
+/**
+ * Check for and handle an authentication failure response.
+ * Returns YES if the response indicates an authentication failure.
+ */
+- (BOOL)handleAuthenticationFailure:(IFHTTPClientResponse *)response;
+/// Apply a fully read updates response to the file DB. Returns a list of follow up commands.
+- (NSArray *)applyUpdateData:(id)updateData;
+/// Complete a streamed refresh. Returns a list of follow up commands.
+- (NSArray *)completeStreamedRefresh:(IFCMSRefreshStream *)stream response:(IFHTTPClientResponse *)response;
+/**
+ * Start the updates transaction.
+ * When starting a new refresh (i.e. not resuming from a checkpoint), also shifts the current
+ * fileset fingerprints to previous and clears the list of files received by the last refresh.
+ */
+- (void)beginUpdates;
+/// Set the ACM group fingerprint reported by the server, and check whether a migration is needed.
+- (void)setUpdateGroup:(NSString *)updateGroup;
+/// Apply a single update record to the file DB.
+- (void)applyUpdate:(NSDictionary *)values toTable:(NSString *)tableName;
+/**
+ * Test whether an update record has already been applied to the file DB.
+ * Used when resuming a refresh to skip records written before the refresh was interrupted,
+ * and when migrating to skip records which are unchanged between the old and new groups.
+ */
+- (BOOL)isUpdateApplied:(NSDictionary *)values toTable:(NSString *)tableName;
+/// Record a refresh checkpoint and commit the current chunk of updates.
+- (void)checkpointUpdates;
+/**
+ * Complete the updates transaction after all update records have been applied.
+ * Deletes obsolete files and records, and returns a list of fileset download commands
+ * for updated fileset categories.
+ */
+- (NSArray *)completeUpdates;
+
+@end
+
+@implementation IFCMSRefreshStream
+
+- (id)initWithCommandProtocol:(IFCMSCommandProtocol *)protocol {
+    self = [super init];
+    if (self) {
+        _protocol = protocol;
+        _fileDB = protocol.fileDB;
+    }
+    return self;
+}
+
+- (BOOL)streamed {
+    return _reader != nil;
+}
+
+- (id)result {
+    return _reader.result;
+}
+
+- (NSData *)bufferedData {
+    return _buffer;
+}
+
+- (void)setGroup:(NSString *)group {
+    _group = group;
+    [_protocol setUpdateGroup:group];
+}
+
+- (void)applyUpdate:(id)values toTable:(NSString *)tableName {
+    if (![values isKindOfClass:[NSDictionary class]]) {
+        return;
+    }
+    [self beginUpdates];
+    [_protocol applyUpdate:values toTable:tableName];
+}
+
+- (void)beginUpdates {
+    if (!_updating) {
+        [_protocol beginUpdates];
+        _updating = YES;
+    }
+}
+
+- (BOOL)finish:(NSError **)error {
+    if (_error) {
+        if (error) {
+            *error = _error;
+        }
+        return NO;
+    }
+    if (_reader) {
+        return [_reader finish:error];
+    }
+    return YES;
+}
+
+- (void)abort {
+    if (_updating) {
+        [_fileDB rollbackTransaction];
+        _updating = NO;
+    }
+}
+
+#pragma mark - IFHTTPClientDataReceiver
+
+- (void)receiveResponse:(NSHTTPURLResponse *)response {
+    if (response.statusCode == 200) {
+        _reader = [IFStreamDataReader readerForMIMEType:response.MIMEType];
+    }
+    if (_reader) {
+        // Apply each record in each table of the updates as soon as it is read.
+        __weak IFCMSRefreshStream *this = self;
+        // The group fingerprint is also streamed so that, if it is received before the file
+        // records, any migration can be detected before the records are applied.
+        _reader.streamedPaths = @[ @"db.*.*", @"repository.group" ];
+        _reader.valueHandler = ^(NSArray *path, id value) {
+            if ([@"repository" isEqualToString:path[0]]) {
+                [this setGroup:value];
+            }
+            else {
+                [this applyUpdate:value toTable:path[1]];
+            }
+        };
+    }
+    else {
+        _buffer = [NSMutableData new];
+    }
+}
+
+- (void)receiveData:(NSData *)data {
+    if (_error) {
+        return;
+    }
+    if (_reader) {
+        NSError *error = nil;
+        if (![_reader appendData:data error:&error]) {
+            _error = error;
+        }
+    }
+    else {
+        [_buffer appendData:data];
+    }
+}
 
 @end
 
@@ -50,6 +366,18 @@
         // Use a copy of the file DB to avoid problems with multi-thread access.
         self.fileDB = [authority.fileDB newInstance];
         self.httpClient = authority.httpClient;
+        self.pathIndex = authority.pathIndex;
+        self.streamUpdates = authority.streamUpdates;
+        self.streamFilesets = authority.streamFilesets;
+        self.chunkSize = authority.refreshChunkSize;
+        self.acceptEncodings = authority.acceptEncodings ? authority.acceptEncodings : [IFHTTPClient nativeAcceptEncodings];
+        // File syncs compare against the blob store manifest, so need a blob store.
+        self.fileSyncLimit = authority.fileDB.blobStore ? authority.fileSyncLimit : 0;
+        self.prefetchLimit = authority.prefetchLimit;
+        self.batchFilesets = authority.batchFilesets;
+        // Fileset deploys copy and write whole directories, so are kept off the HTTP client's queues.
+        _deployQueue = dispatch_queue_create("com.innerfunction.semo.cms.Deploy", DISPATCH_QUEUE_SERIAL);
+        [self purgeRetiredFilesetDirectories];
         // Register command handlers.
         __block id this = self;
         [self addCommand:@"refresh" withBlock:^QPromise *(NSArray *args) {
@@ -63,6 +391,18 @@
         [self addCommand:@"download-fileset" withBlock:^QPromise *(NSArray *args) {
             return [this downloadFileset:args];
         }];
+        [self addCommand:@"download-filesets" withBlock:^QPromise *(NSArray *args) {
+            return [this downloadFilesets:args];
+        }];
+        [self addCommand:@"sync-files" withBlock:^QPromise *(NSArray *args) {
+            return [this syncFiles:args];
+        }];
+        [self addCommand:@"prefetch-file" withBlock:^QPromise *(NSArray *args) {
+            return [this prefetchFile:args];
+        }];
+        [self addCommand:@"purge-deleted-files" withBlock:^QPromise *(NSArray *args) {
+            return [this purgeDeletedFiles:args];
+        }];
     }
     return self;
 }
@@ -78,44 +418,84 @@
     NSMutableDictionary *params = [NSMutableDictionary new];
     params[@"secure"] = IsSecure;
     
-    // Read current group fingerprint.
-    NSDictionary *record = [_fileDB readRecordWithID:@"$group" fromTable:@"fingerprints"];
-    if (record) {
-        group = record[@"current"];
+    _updatedCategories = [NSMutableDictionary new];
+    _chunkRowCount = 0;
+    _appliedRowCount = 0;
+    
+    // Check for a checkpoint left by an interrupted refresh.
+    NSDictionary *checkpoint = [_fileDB readRecordWithID:RefreshCheckpointID fromTable:@"checkpoints"];
+    _resuming = (checkpoint != nil);
+    _migrating = NO;
+    // Updates may have been committed by the interrupted refresh.
+    _filesChanged = _resuming;
+    if (_resuming) {
+        // Resume the interrupted refresh; request updates using the same group and commit as the
+        // original request, as the file DB may now contain some of the updated commit records.
+        group = checkpoint[@"groupid"];
+        commit = checkpoint[@"commitid"];
+        // Updates written before the interruption were committed, but not yet reported as changes.
+        _appliedRowCount = [checkpoint[@"rowcount"] integerValue];
+        NSData *json = [checkpoint[@"categories"] dataUsingEncoding:NSUTF8StringEncoding];
+        if (json) {
+            NSDictionary *categories = [NSJSONSerialization JSONObjectWithData:json options:0 error:nil];
+            if ([categories isKindOfClass:[NSDictionary class]]) {
+                [_updatedCategories addEntriesFromDictionary:categories];
+            }
+        }
+    }
+    else {
+        // Read current group fingerprint.
+        NSDictionary *record = [_fileDB readRecordWithID:@"$group" fromTable:@"fingerprints"];
+        if (record) {
+            group = record[@"current"];
+        }
+        // Read latest commit ID.
+        NSArray *rs = [_fileDB performQuery:@"SELECT id, max(date) FROM commits" withParams:@[]];
+        if ([rs count] > 0) {
+            // File DB contains previous commits, read latest commit ID.
+            NSDictionary *record = rs[0];
+            commit = [record[@"id"] description];
+        }
+    }
+    if (group) {
         params[@"group"] = group;
     }
-    
-    // Read latest commit ID.
-    NSArray *rs = [_fileDB performQuery:@"SELECT id, max(date) FROM commits" withParams:@[]];
-    if ([rs count] > 0) {
-        // File DB contains previous commits, read latest commit ID and add as request parameter.
-        NSDictionary *record = rs[0];
-        commit = [record[@"id"] description];
+    if (commit) {
         params[@"since"] = commit;
     }
     // Otherwise simply omit the 'since' parameter; the feed will return all records in the file DB.
+    
+    _refreshGroup = group;
+    _refreshCommit = commit;
 
     // Specify accepts options.
     NSDictionary *options = @{
         IFHTTPClientRequestOptionAccept:            AcceptMIMETypes,
-        IFHTTPClientRequestOptionAcceptEncoding:    AcceptEncodings
+        IFHTTPClientRequestOptionAcceptEncoding:    _acceptEncodings
     };
+    
+    if (_streamUpdates) {
+        // Fetch updates from the server and apply them to the database as they arrive.
+        IFCMSRefreshStream *stream = [[IFCMSRefreshStream alloc] initWithCommandProtocol:self];
+        [_httpClient get:refreshURL data:params options:options receiver:stream]
+        .then((id)^(IFHTTPClientResponse *response) {
+            [self finishRefresh:[self completeStreamedRefresh:stream response:response] response:response hint:nil];
+            return nil;
+        })
+        .fail(^(id error) {
+            [stream abort];
+            NSString *msg = [NSString stringWithFormat:@"Updates download from %@ failed: %@", refreshURL, error];
+            [self failRefresh:msg];
+        });
+        return _promise;
+    }
+    
     // Fetch updates from the server.
     [_httpClient get:refreshURL data:params options:options]
     .then((id)^(IFHTTPClientResponse *response) {
-    
-        // Create list of follow up commands.
-        NSMutableArray *commands = [NSMutableArray new];
-        NSInteger responseCode = response.httpResponse.statusCode;
-        if (responseCode == 401) {
-            // Authentication failure.
-            if (_logoutAction) {
-                [[IFAppContainer getAppContainer] postMessage:_logoutAction sender:self];
-            }
-            else {
-                [_authManager removeCredentials];
-            }
-            [_promise resolve:commands];
+        
+        if ([self handleAuthenticationFailure:response]) {
+            [self finishRefresh:@[] response:response hint:nil];
             return nil;
         }
         
@@ -124,149 +504,387 @@
         if ([updateData isKindOfClass:[NSString class]]) {
             // Indicates a server error
             NSLog(@"%@ %@", response.httpResponse.URL, updateData);
-            [_promise resolve:commands];
+            [self finishRefresh:@[] response:response hint:nil];
             return nil;
         }
 
-        /*
-        // Check file DB schema version.
-        id version = [updateData valueForKeyPath:@"db.version"];
-        if (![version isEqual:_fileDB.version]) {
-            // Update the file DB schema and then schedule a new refresh.
-            id updateSchema = @{
-                @"name": [self qualifyName:@"update-schema"],
-                @"args": @[ version ]
-            };
-            id refresh = @{
-                @"name": [self qualifyName:@"refresh"],
-                @"args": @[]
-            };
-            [commands addObject:updateSchema];
-            [commands addObject:refresh];
-            NSLog(@"Database version mismatch error");
+        id hint = [updateData isKindOfClass:[NSDictionary class]] ? [updateData valueForKeyPath:@"repository.nextCheck"] : nil;
+        [self finishRefresh:[self applyUpdateData:updateData] response:response hint:hint];
+        return nil;
+    })
+    .fail(^(id error) {
+        NSString *msg = [NSString stringWithFormat:@"Updates download from %@ failed: %@", refreshURL, error];
+        [self failRefresh:msg];
+    });
+    
+    // Return deferred promise.
+    return _promise;
+}
+
+- (void)finishRefresh:(NSArray *)commands response:(IFHTTPClientResponse *)response hint:(id)hint {
+    // The refresh found changes if it wrote or deleted any records.
+    BOOL changed = _appliedRowCount > 0;
+    [_fileDB.authority refreshDidCompleteWithChanges:changed nextCheck:[self nextCheckForResponse:response hint:hint]];
+    [_promise resolve:commands];
+}
+
+- (void)failRefresh:(NSString *)message {
+    [_fileDB.authority refreshDidCompleteWithChanges:NO nextCheck:0];
+    [_promise reject:message];
+}
+
+- (NSTimeInterval)nextCheckForResponse:(IFHTTPClientResponse *)response hint:(id)hint {
+    // A Retry-After header can be a number of seconds or an HTTP date.
+    NSString *retryAfter = [response.httpResponse valueForHTTPHeaderField:@"Retry-After"];
+    if ([retryAfter length] > 0) {
+        NSTimeInterval seconds = [retryAfter doubleValue];
+        if (seconds > 0) {
+            return seconds;
+        }
+        NSDateFormatter *formatter = [NSDateFormatter new];
+        formatter.locale = [NSLocale localeWithLocaleIdentifier:@"en_US_POSIX"];
+        formatter.dateFormat = @"EEE, dd MMM yyyy HH:mm:ss zzz";
+        NSDate *date = [formatter dateFromString:retryAfter];
+        if (date && [date timeIntervalSinceNow] > 0) {
+            return [date timeIntervalSinceNow];
+        }
+    }
+    if ([hint respondsToSelector:@selector(doubleValue)] && [hint doubleValue] > 0) {
+        return [hint doubleValue];
+    }
+    return 0;
+}
+
+- (BOOL)handleAuthenticationFailure:(IFHTTPClientResponse *)response {
+    if (response.httpResponse.statusCode == 401) {
+        if (_logoutAction) {
+            // Response handlers run on the HTTP client's callback queue; post the logout action
+            // on the main queue, as it will normally result in UI changes.
+            NSString *logoutAction = _logoutAction;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                [[IFAppContainer getAppContainer] postMessage:logoutAction sender:self];
+            });
         }
         else {
-        */
-            // Write updates to database.
-            NSDictionary *updates = [updateData valueForKeyPath:@"db"];
-            if ([@0 isEqual:updates]) {
-                // This can happen no updates to report from the server; replace updates
-                // with an empty dictionary.
-                updates = @{};
-            }
-            // A map of fileset category names to a 'since' commit value (may be null).
-            NSMutableDictionary *updatedCategories = [NSMutableDictionary new];
-        
-            // Start a DB transaction.
-            [_fileDB beginTransaction];
-        
-        
-            // Check group fingerprint to see if a migration is needed.
-            NSString *updateGroup = [updateData valueForKeyPath:@"repository.group"];
-            BOOL migrate = ![group isEqualToString:updateGroup];
-            if (migrate) {
-                // Performing a migration due to an ACM group ID change; mark all files as
-                // provisionaly deleted.
-                [_fileDB performUpdate:@"UPDATE files SET status='deleted'" withParams:@[]];
+            [_authManager removeCredentials];
+        }
+        return YES;
+    }
+    return NO;
+}
+
+- (NSArray *)applyUpdateData:(id)updateData {
+    /*
+    // Check file DB schema version.
+    id version = [updateData valueForKeyPath:@"db.version"];
+    if (![version isEqual:_fileDB.version]) {
+        // Update the file DB schema and then schedule a new refresh.
+        id updateSchema = @{
+            @"name": [self qualifyName:@"update-schema"],
+            @"args": @[ version ]
+        };
+        id refresh = @{
+            @"name": [self qualifyName:@"refresh"],
+            @"args": @[]
+        };
+        NSLog(@"Database version mismatch error");
+        return @[ updateSchema, refresh ];
+    }
+    */
+    // Write updates to database.
+    NSDictionary *updates = [updateData valueForKeyPath:@"db"];
+    if ([@0 isEqual:updates]) {
+        // This can happen no updates to report from the server; replace updates
+        // with an empty dictionary.
+        updates = @{};
+    }
+
+    // Start a DB transaction.
+    [self beginUpdates];
+
+    // Check group fingerprint to see if a migration is needed.
+    NSString *updateGroup = [updateData valueForKeyPath:@"repository.group"];
+    [self setUpdateGroup:updateGroup];
+
+    // Apply all downloaded updates to the database.
+    for (NSString *tableName in updates) {
+        NSArray *table = updates[tableName];
+        for (NSDictionary *values in table) {
+            [self applyUpdate:values toTable:tableName];
+        }
+    }
+    
+    return [self completeUpdates];
+}
+
+- (NSArray *)completeStreamedRefresh:(IFCMSRefreshStream *)stream response:(IFHTTPClientResponse *)response {
+    
+    if ([self handleAuthenticationFailure:response]) {
+        [stream abort];
+        return @[];
+    }
+    NSError *error = nil;
+    if (![stream finish:&error]) {
+        NSLog(@"%@ %@", response.httpResponse.URL, error);
+        [stream abort];
+        return @[];
+    }
+    if (!stream.streamed) {
+        // The response wasn't in a streamable format (e.g. a server error message); process
+        // the buffered response data in the normal way.
+        response.data = stream.bufferedData;
+        id updateData = [response parseData];
+        if ([updateData isKindOfClass:[NSString class]]) {
+            // Indicates a server error
+            NSLog(@"%@ %@", response.httpResponse.URL, updateData);
+            return @[];
+        }
+        return [self applyUpdateData:updateData];
+    }
+    // Start the updates transaction, if no rows were received.
+    [stream beginUpdates];
+    // Check group fingerprint, in case it was received after the file records.
+    [self setUpdateGroup:stream.group];
+    return [self completeUpdates];
+}
+
+- (void)beginUpdates {
+    [_fileDB beginTransaction];
+    if (!_resuming) {
+        // Clear the list of files received by the previous refresh.
+        [_fileDB performUpdate:@"DELETE FROM refresh_files" withParams:@[]];
+        // Shift current fileset fingerprints to previous.
+        [_fileDB performUpdate:@"UPDATE fingerprints SET previous=current" withParams:@[]];
+    }
+}
+
+- (void)setUpdateGroup:(NSString *)updateGroup {
+    BOOL migrating = ![_refreshGroup isEqualToString:updateGroup];
+    if (migrating && !_migrating) {
+        // Files already received may have entered the group, and may predate the since commit;
+        // require full fileset downloads for their categories.
+        for (id category in [_updatedCategories allKeys]) {
+            _updatedCategories[category] = [NSNull null];
+        }
+    }
+    _migrating = migrating;
+}
+
+- (void)applyUpdate:(NSDictionary *)values toTable:(NSString *)tableName {
+    
+    BOOL isFile = [@"files" isEqualToString:tableName];
+    if (isFile) {
+        // Record the IDs of received files; after a group migration, any file not in this list
+        // has left the group. This is done before the update is applied so that the ID is
+        // written in the same chunk as the update.
+        id fileID = values[@"id"];
+        if (fileID) {
+            [_fileDB performUpdate:@"INSERT OR IGNORE INTO refresh_files (id) VALUES (?)" withParams:@[ fileID ]];
+        }
+    }
+    // When resuming, records may have been written before the refresh was interrupted. Note that
+    // these can't be skipped by position, as the server doesn't guarantee record order between requests.
+    // When migrating, the server returns the full set of records for the new group, most of which
+    // will normally be unchanged.
+    BOOL applied = (_resuming || _migrating) && [self isUpdateApplied:values toTable:tableName];
+    if (!applied) {
+        [_fileDB upsertValues:values intoTable:tableName];
+        _appliedRowCount++;
+    }
+    // If processing the files table then record the updated file category name.
+    if (isFile && !applied) {
+        _filesChanged = YES;
+        NSString *category = values[@"category"];
+        NSString *status = values[@"status"];
+        if (category != nil && ![@"deleted" isEqualToString:status]) {
+            // Cancel any pending deletion of a previous file at the same cache location.
+            NSString *path = [_fileDB filesetLocationForFile:values];
+            if (path) {
+                [_fileDB deleteID:path fromTable:@"tombstones"];
             }
-        
-            // Shift current fileset fingerprints to previous.
-            [_fileDB performUpdate:@"UPDATE fingerprints SET previous=current" withParams:@[]];
-
-            // Apply all downloaded updates to the database.
-            for (NSString *tableName in updates) {
-                BOOL isFilesTable = [@"files" isEqualToString:tableName];
-                NSArray *table = updates[tableName];
-                for (NSDictionary *values in table) {
-                    [_fileDB upsertValues:values intoTable:tableName];
-                    // If processing the files table then record the updated file category name.
-                    if (isFilesTable) {
-                        NSString *category = values[@"category"];
-                        NSString *status = values[@"status"];
-                        if (category != nil && ![@"deleted" isEqualToString:status]) {
-                            if (commit) {
-                                updatedCategories[category] = commit;
-                            }
-                            else {
-                                updatedCategories[category] = [NSNull null];
-                            }
-                        }
-                    }
+            if (_refreshCommit && !_migrating) {
+                // Don't replace a full download requirement for the category.
+                if (_updatedCategories[category] != [NSNull null]) {
+                    _updatedCategories[category] = _refreshCommit;
                 }
             }
-        
-            // Check for deleted files.
-            NSFileManager *fileManager = [NSFileManager defaultManager];
-            NSArray *deleted = [_fileDB performQuery:@"SELECT id, path FROM files WHERE status='deleted'" withParams:@[]];
-            for (NSDictionary *record in deleted) {
-                // Delete cached file, if exists.
-                NSString *path = [_fileDB cacheLocationForFile:record];
-                if (path && [fileManager fileExistsAtPath:path]) {
-                    [fileManager removeItemAtPath:path error:nil];
-                }
+            else {
+                // A file entering the group during a migration may predate the since commit,
+                // so a full fileset download is needed.
+                _updatedCategories[category] = [NSNull null];
             }
-        
-            // Delete obsolete records.
-            [_fileDB performUpdate:@"DELETE FROM files WHERE status='deleted'" withParams:@[]];
+        }
+    }
+    _chunkRowCount++;
+    if (_chunkSize > 0 && _chunkRowCount >= _chunkSize) {
+        [self checkpointUpdates];
+    }
+}
 
-            // Prune ORM related records.
-            [_fileDB pruneRelatedValues];
-        
-            // Read list of fileset names with modified fingerprints.
-            NSArray *rows = [_fileDB performQuery:@"SELECT category FROM fingerprints WHERE current != previous" withParams:@[]];
-            for (NSDictionary *row in rows) {
-                NSString *category = row[@"category"];
-                if ([@"$group" isEqualToString:category]) {
-                    // The ACM group fingerprint entry - skip.
-                    continue;
-                }
-                // Map the category name to null - this indicates that the category is updated,
-                // but there is no 'since' parameter, so download a full update.
-                updatedCategories[category] = [NSNull null];
+- (BOOL)isUpdateApplied:(NSDictionary *)values toTable:(NSString *)tableName {
+    NSString *idColumn = [_fileDB getColumnWithTag:@"id" fromTable:tableName];
+    NSString *versionColumn = [_fileDB getColumnWithTag:@"version" fromTable:tableName];
+    if (!idColumn || !versionColumn) {
+        // Can't tell whether the record is current, so apply it again.
+        return NO;
+    }
+    id identifier = values[idColumn];
+    id version = values[versionColumn];
+    if (!identifier || !version) {
+        return NO;
+    }
+    NSString *where = [NSString stringWithFormat:@"%@=? AND %@=?", idColumn, versionColumn];
+    return [_fileDB countInTable:tableName where:where withParams:@[ identifier, version ]] > 0;
+}
+
+- (void)checkpointUpdates {
+    NSData *json = [NSJSONSerialization dataWithJSONObject:_updatedCategories options:0 error:nil];
+    NSString *categories = [[NSString alloc] initWithData:json encoding:NSUTF8StringEncoding];
+    NSDictionary *checkpoint = @{
+        @"id":          RefreshCheckpointID,
+        @"commitid":    (_refreshCommit ? _refreshCommit : [NSNull null]),
+        @"groupid":     (_refreshGroup ? _refreshGroup : [NSNull null]),
+        @"categories":  (categories ? categories : @"{}"),
+        @"rowcount":    [NSNumber numberWithInteger:_appliedRowCount]
+    };
+    // Write the checkpoint in the same transaction as the updates it records.
+    [_fileDB upsertValues:checkpoint intoTable:@"checkpoints"];
+    [_fileDB commitTransaction];
+    [_fileDB beginTransaction];
+    _chunkRowCount = 0;
+}
+
+- (NSArray *)completeUpdates {
+    
+    // Create list of follow up commands.
+    NSMutableArray *commands = [NSMutableArray new];
+
+    if (_migrating) {
+        // Performing a migration due to an ACM group ID change. Files which were in the old group
+        // but weren't received from the new group have left the group, and are deleted. The group
+        // ID may not be known until after all file records have been received, so this can't be
+        // done in advance.
+        [_fileDB performUpdate:@"UPDATE files SET status='deleted' WHERE id NOT IN (SELECT id FROM refresh_files)"
+                    withParams:@[]];
+    }
+    
+    // Check for deleted files. Cached copies of deleted files aren't removed here, as doing so would
+    // extend the transaction with file system I/O; instead, record a tombstone for each cached file
+    // location, and delete the files in the background once the transaction has committed.
+    NSArray *deleted = [_fileDB performQuery:@"SELECT id, path, category FROM files WHERE status='deleted'" withParams:@[]];
+    if ([deleted count] > 0) {
+        _filesChanged = YES;
+        _appliedRowCount += [deleted count];
+    }
+    for (NSDictionary *record in deleted) {
+        // Note that the fileset location is used, so that a shared blob is never deleted directly;
+        // blobs are purged once no fileset location links to them.
+        NSString *path = [_fileDB filesetLocationForFile:record];
+        if (path) {
+            [_fileDB performUpdate:@"INSERT OR IGNORE INTO tombstones (path) VALUES (?)" withParams:@[ path ]];
+        }
+    }
+    [_fileDB performUpdate:@"DELETE FROM manifest WHERE path IN (SELECT path FROM files WHERE status='deleted')"
+                withParams:@[]];
+
+    // Delete obsolete records.
+    [_fileDB performUpdate:@"DELETE FROM files WHERE status='deleted'" withParams:@[]];
+
+    // Prune ORM related records.
+    [_fileDB pruneRelatedValues];
+
+    // Read list of fileset names with modified fingerprints.
+    NSArray *rows = [_fileDB performQuery:@"SELECT category FROM fingerprints WHERE current != previous" withParams:@[]];
+    for (NSDictionary *row in rows) {
+        NSString *category = row[@"category"];
+        if ([@"$group" isEqualToString:category]) {
+            // The ACM group fingerprint entry - skip.
+            continue;
+        }
+        // Map the category name to null - this indicates that the category is updated,
+        // but there is no 'since' parameter, so download a full update.
+        _updatedCategories[category] = [NSNull null];
+    }
+
+    // Queue downloads of updated category filesets.
+    NSMutableArray *downloads = [NSMutableArray new];
+    for (id category in [_updatedCategories keyEnumerator]) {
+        id since = _updatedCategories[category];
+        // Get cache location for fileset; if nil then don't download the fileset.
+        NSString *cacheLocation = [_fileDB cacheLocationForFileset:category];
+        // If the cached copy of the fileset already matches the expected files (e.g. a fingerprint
+        // change due to metadata only, or the files arrived via another route) then nothing needs
+        // to be downloaded.
+        if (cacheLocation && _fileDB.blobStore) {
+            NSString *localRoot = [self localTreeForFileset:category].rootHash;
+            if (localRoot && [localRoot isEqualToString:[self expectedTreeForFileset:category].rootHash]) {
+                [_fileDB performUpdate:@"UPDATE fingerprints SET previous=current WHERE category=?"
+                            withParams:@[ category ]];
+                continue;
             }
-        
-            // Queue downloads of updated category filesets.
-            NSString *command = [self qualifyName:@"download-fileset"];
-            for (id category in [updatedCategories keyEnumerator]) {
-                id since = updatedCategories[category];
-                // Get cache location for fileset; if nil then don't download the fileset.
-                NSString *cacheLocation = [_fileDB cacheLocationForFileset:category];
-                if (cacheLocation) {
-                    NSMutableArray *args = [NSMutableArray new];
-                    [args addObject:category];
-                    [args addObject:cacheLocation]; // Where to put the downloaded files.
-                    if (since != [NSNull null]) {
-                        [args addObject:since];
-                    }
-                    [commands addObject:@{ @"name": command, @"args": args }];
-                }
+        }
+        // If only a few of the fileset's files have changed then download them individually;
+        // larger change sets fall back to a fileset zip download.
+        if (cacheLocation && _fileSyncLimit > 0) {
+            NSArray *files = [self filesToSyncInFileset:category limit:_fileSyncLimit + 1];
+            if (files && (NSInteger)[files count] <= _fileSyncLimit) {
+                NSString *syncCommand = [self qualifyName:@"sync-files"];
+                [commands addObject:@{ @"name": syncCommand, @"args": @[ category ], @"lane": @"network" }];
+                continue;
             }
-
-            // Commit the transaction.
-            [_fileDB commitTransaction];
-            
-            // QUESTIONS ABOUT THE CODE ABOVE
-            // 1. How does the code perform if the procedure above is interrupted before completion?
-            // 2. How is app performance affected if the procedure above is continually interrupted?
-            //    (e.g. due to repeated short-duration app starts).
-            // 3. Are there ways (on iOS and Android) to run tasks like this with completion guarantees?
-            //    e.g. the scheduler could register as a background task when app is put into the background;
-            //    the task compeletes when the currently executing command completes.
-            //    See https://developer.apple.com/library/content/documentation/iPhone/Conceptual/iPhoneOSProgrammingGuide/BackgroundExecution/BackgroundExecution.html
-            
-        /* -- end of else after db version check
         }
-        */
-        [_promise resolve:commands];
-        return nil;
-    })
-    .fail(^(id error) {
-        NSString *msg = [NSString stringWithFormat:@"Updates download from %@ failed: %@", refreshURL, error];
-        [_promise reject:msg];
-    });
+        if (cacheLocation) {
+            NSMutableArray *args = [NSMutableArray new];
+            [args addObject:category];
+            [args addObject:cacheLocation]; // Where to put the downloaded files.
+            if (since != [NSNull null]) {
+                [args addObject:since];
+            }
+            [downloads addObject:args];
+        }
+    }
+    if (_batchFilesets && !_batchFilesetsUnsupported && [downloads count] > 1) {
+        // Download all the filesets in a single request.
+        [commands addObject:@{ @"name": [self qualifyName:@"download-filesets"], @"args": downloads, @"lane": @"network" }];
+    }
+    else {
+        [commands addObjectsFromArray:[self filesetDownloadCommands:downloads]];
+    }
+
+    // Queue prefetches of files referenced by updated posts. These have a lower priority than the
+    // fileset downloads, which may include many of the same files.
+    if (_prefetchLimit > 0 && _filesChanged && !_migrating) {
+        [commands addObjectsFromArray:[self prefetchCommands]];
+    }
+
+    // Remove the refresh checkpoint, if any; the refresh is complete once the transaction commits.
+    [_fileDB deleteID:RefreshCheckpointID fromTable:@"checkpoints"];
+
+    // Commit the transaction.
+    [_fileDB commitTransaction];
+
+    // Update the path index with the committed file records.
+    if (_filesChanged) {
+        [_pathIndex reload];
+    }
+
+    // Queue deletion of obsolete cached files. Tombstones may also remain from an earlier refresh
+    // if the app was terminated before they were all processed. The deletion is queued with a low
+    // priority so that it runs after the fileset downloads.
+    if ([_fileDB countInTable:@"tombstones" where:@"1=1"] > 0) {
+        [commands addObject:@{ @"name": [self qualifyName:@"purge-deleted-files"], @"args": @[], @"priority": @1 }];
+    }
     
-    // Return deferred promise.
-    return _promise;
+    // QUESTIONS ABOUT THE CODE ABOVE
+    // 1. How does the code perform if the procedure above is interrupted before completion?
+    // 2. How is app performance affected if the procedure above is continually interrupted?
+    //    (e.g. due to repeated short-duration app starts).
+    // 3. Are there ways (on iOS and Android) to run tasks like this with completion guarantees?
+    //    e.g. the scheduler could register as a background task when app is put into the background;
+    //    the task compeletes when the currently executing command completes.
+    //    See https://developer.apple.com/library/content/documentation/iPhone/Conceptual/iPhoneOSProgrammingGuide/BackgroundExecution/BackgroundExecution.html
+    
+    return commands;
 }
 
 /*
@@ -304,7 +922,8 @@
 
 - (QPromise *)downloadFileset:(NSArray *)args {
     
-    _promise = [QPromise new];
+    // Note that a local promise is used, as fileset downloads may execute concurrently.
+    QPromise *promise = [QPromise new];
     
     id category = args[0];
     id cachePath = args[1];
@@ -317,30 +936,839 @@
         data[@"since"] = args[2];
     }
     
-    // Download the fileset.
-    [_httpClient getFile:filesetURL data:data]
+    // Fileset downloads run concurrently with other network commands, so the file DB is only accessed
+    // on the command execution queue; read the fileset's current manifest now, while on that queue.
+    dispatch_queue_t execQueue = [IFCommandScheduler getCommandExecutionQueue];
+    NSDictionary *manifest = _fileDB.blobStore ? [_fileDB manifestForFileset:category] : nil;
+    
+    // Download the fileset. The request is conditional on the fileset's last download, if the
+    // fileset has previously been downloaded to the cache location.
+    NSString *stagingPath = [_fileDB.authority.stagingPath stringByAppendingPathComponent:@"filesets"];
+    if (_streamFilesets) {
+        // Extract the fileset into the staging directory as it downloads; the staging directory is
+        // created on the deploy queue before the request is started.
+        NSDictionary *options = @{
+            IFHTTPClientRequestOptionAcceptEncoding:    _acceptEncodings,
+            IFHTTPClientRequestOptionCachedLocation:    cachePath
+        };
+        dispatch_async(_deployQueue, ^{
+            NSString *extractPath = [self stageFileset:category fromPath:cachePath];
+            if (!extractPath) {
+                [promise reject:[NSString stringWithFormat:@"Failed to stage fileset %@", category]];
+                return;
+            }
+            IFZipStreamExtractor *extractor = [[IFZipStreamExtractor alloc] initWithPath:extractPath];
+            [_httpClient get:filesetURL data:data options:options receiver:extractor]
+            .then((id)^(IFHTTPClientResponse *response) {
+                dispatch_async(_deployQueue, ^{
+                    NSError *error = nil;
+                    if (![extractor finish:&error]) {
+                        [self retireFilesetDirectory:extractPath];
+                        NSString *msg = [NSString stringWithFormat:@"Fileset extraction from %@ failed: %@", filesetURL, error];
+                        [promise reject:msg];
+                        return;
+                    }
+                    NSDictionary *published = nil;
+                    if (!extractor.extracted) {
+                        // Nothing downloaded, e.g. fileset not modified; discard the staged copy.
+                        [self retireFilesetDirectory:extractPath];
+                    }
+                    else {
+                        published = [self publishStagedFileset:extractPath category:category toPath:cachePath previousManifest:manifest];
+                        if (!published) {
+                            [self retireFilesetDirectory:extractPath];
+                            NSString *msg = [NSString stringWithFormat:@"Failed to publish fileset %@", category];
+                            [promise reject:msg];
+                            return;
+                        }
+                    }
+                    dispatch_async(execQueue, ^{
+                        if (published) {
+                            [self recordPublishedFileset:category atPath:cachePath manifest:published];
+                        }
+                        [self completeFilesetDownload:category response:response];
+                        [promise resolve:@[]];
+                    });
+                });
+                return nil;
+            })
+            .fail(^(id error) {
+                [self retireFilesetDirectory:extractPath];
+                NSString *msg = [NSString stringWithFormat:@"Fileset download from %@ failed: %@", filesetURL, error];
+                [promise reject:msg];
+            });
+        });
+        return promise;
+    }
+    // The download is resumable, with any partial download kept in the staging directory.
+    NSString *resumePath = [stagingPath stringByAppendingPathComponent:[category stringByAppendingPathExtension:@"zip"]];
+    NSDictionary *options = @{
+        IFHTTPClientRequestOptionAcceptEncoding:    _acceptEncodings,
+        IFHTTPClientRequestOptionCachedLocation:    cachePath,
+        IFHTTPClientRequestOptionResumePath:        resumePath
+    };
+    [_httpClient getFile:filesetURL data:data options:options]
     .then((id)^(IFHTTPClientResponse *response) {
         NSInteger responseCode = response.httpResponse.statusCode;
+        NSString *downloadPath = nil;
         if (responseCode == 200) {
-            // Unzip downloaded file to content location.
+            downloadPath = [self keepDownloadedFile:response withName:category];
+            if (!downloadPath) {
+                [promise reject:[NSString stringWithFormat:@"Failed to keep fileset %@ download", category]];
+                return nil;
+            }
+        }
+        dispatch_async(_deployQueue, ^{
+            NSDictionary *published = nil;
+            if (downloadPath) {
+                // Unzip downloaded file into a staged copy of the fileset, and then publish the result.
+                NSString *stagedPath = [self stageFileset:category fromPath:cachePath];
+                NSError *error = nil;
+                if (stagedPath && [IFZipExtractor extractArchiveAtPath:downloadPath toPath:stagedPath overwrite:YES error:&error]) {
+                    published = [self publishStagedFileset:stagedPath category:category toPath:cachePath previousManifest:manifest];
+                }
+                [[NSFileManager defaultManager] removeItemAtPath:downloadPath error:nil];
+                if (!published) {
+                    if (stagedPath) {
+                        [self retireFilesetDirectory:stagedPath];
+                    }
+                    NSString *msg = [NSString stringWithFormat:@"Failed to deploy fileset %@: %@", category, error];
+                    [promise reject:msg];
+                    return;
+                }
+            }
+            dispatch_async(execQueue, ^{
+                if (published) {
+                    [self recordPublishedFileset:category atPath:cachePath manifest:published];
+                }
+                [self completeFilesetDownload:category response:response];
+                // Resolve empty list - no follow-on commands.
+                [promise resolve:@[]];
+            });
+        });
+        return nil;
+    })
+    .fail(^(id error) {
+        NSString *msg = [NSString stringWithFormat:@"Fileset download from %@ failed: %@", filesetURL, error];
+        [promise reject:msg];
+    });
+
+    // Return deferred promise.
+    return promise;
+}
+
+- (QPromise *)syncFiles:(NSArray *)args {
+
+    // Note that a local promise is used, as file syncs may execute concurrently.
+    QPromise *promise = [QPromise new];
+
+    NSString *category = args[0];
+    NSArray *files = [self filesToSyncInFileset:category limit:FileSyncBatchSize];
+    if (!files) {
+        [promise reject:[NSString stringWithFormat:@"Fileset %@ can't be synced by file", category]];
+        return promise;
+    }
+    if ([files count] == 0) {
+        // All files synced; update the fileset's directory tree and fingerprint.
+        [self updateLocalTreeForFileset:category];
+        [_fileDB performUpdate:@"UPDATE fingerprints SET previous=current WHERE category=?" withParams:@[ category ]];
+        [promise resolve:@[]];
+        return promise;
+    }
+
+    // Download the batch's files concurrently; the HTTP client's rate governor limits the number of
+    // requests in flight. Note that the file DB is only accessed on the command execution queue, as
+    // other network commands may be running.
+    dispatch_queue_t execQueue = [IFCommandScheduler getCommandExecutionQueue];
+    IFCMSBlobStore *blobStore = _fileDB.blobStore;
+    IFCMSCacheManager *cacheManager = _fileDB.authority.cacheManager;
+    dispatch_group_t group = dispatch_group_create();
+    NSMutableArray *failures = [NSMutableArray new];
+    for (NSDictionary *file in files) {
+        NSString *hash = file[@"hash"];
+        NSString *filesetPath = [_fileDB filesetLocationForFile:file];
+        // Link to an existing copy of the same content, if there is one.
+        if ([blobStore hasBlob:hash] && [blobStore linkBlob:hash toPath:filesetPath]
+            && [_fileDB updateManifestEntry:[blobStore manifestEntryForFileAtPath:filesetPath hash:hash] forFile:file]) {
+            [cacheManager addFile:file atPath:filesetPath];
+            continue;
+        }
+        dispatch_group_enter(group);
+        NSString *url = [_cms urlForFile:file[@"path"]];
+        [_httpClient getFile:url]
+        .then((id)^(IFHTTPClientResponse *response) {
             NSString *downloadPath = [response.downloadLocation path];
-            [IFFileIO unzipFileAtPath:downloadPath toPath:cachePath overwrite:YES];
+            // Check that the downloaded content matches the file record, before moving it into the
+            // fileset directory; a mismatch means the file has been updated again since the refresh.
+            NSString *downloadHash = [IFCMSBlobStore hashOfFileAtPath:downloadPath];
+            BOOL ok = response.httpResponse.statusCode == 200 && [hash isEqualToString:downloadHash];
+            if (ok) {
+                NSFileManager *fileManager = [NSFileManager defaultManager];
+                [fileManager createDirectoryAtPath:[filesetPath stringByDeletingLastPathComponent]
+                       withIntermediateDirectories:YES
+                                        attributes:nil
+                                             error:nil];
+                // Rename the file into place, so that readers never see a partial file.
+                ok = rename([downloadPath fileSystemRepresentation], [filesetPath fileSystemRepresentation]) == 0
+                  && [blobStore addFileAtPath:filesetPath] != nil;
+            }
+            NSDictionary *entry = ok ? [blobStore manifestEntryForFileAtPath:filesetPath hash:hash] : nil;
+            dispatch_async(execQueue, ^{
+                if ([_fileDB updateManifestEntry:entry forFile:file]) {
+                    [cacheManager addFile:file atPath:filesetPath];
+                }
+                else {
+                    @synchronized (failures) {
+                        [failures addObject:file[@"path"]];
+                    }
+                }
+                dispatch_group_leave(group);
+            });
+            return nil;
+        })
+        .fail(^(id error) {
+            @synchronized (failures) {
+                [failures addObject:file[@"path"]];
+            }
+            dispatch_group_leave(group);
+        });
+    }
+
+    dispatch_group_notify(group, execQueue, ^{
+        if ([failures count] > 0) {
+            // The fileset's fingerprint isn't updated, so the sync is retried after the next refresh.
+            NSString *msg = [NSString stringWithFormat:@"Failed to sync files in fileset %@: %@", category, failures];
+            [promise reject:msg];
+        }
+        else {
+            // Queue a follow up sync; this either syncs the next batch, or completes the sync.
+            NSArray *commands = @[ @{ @"name": [self qualifyName:@"sync-files"], @"args": @[ category ], @"lane": @"network" } ];
+            [promise resolve:commands];
+        }
+    });
+
+    // Return deferred promise.
+    return promise;
+}
+
+- (NSArray *)filesToSyncInFileset:(NSString *)category limit:(NSInteger)limit {
+    // Files without a content hash can only be updated by a fileset zip download.
+    NSInteger unhashed = [_fileDB countInTable:@"files"
+                                         where:@"category=? AND status != 'packaged' AND hash IS NULL"
+                                    withParams:@[ category ]];
+    if (unhashed > 0) {
+        return nil;
+    }
+    NSMutableArray *params = [NSMutableArray arrayWithObject:category];
+    NSString *dirFilter = @"";
+    // Compare the expected and cached directory trees, to find the directories containing changes.
+    IFCMSMerkleTree *expected = [self expectedTreeForFileset:category];
+    IFCMSMerkleTree *local = [self localTreeForFileset:category];
+    if (expected && local) {
+        NSArray *dirs = [expected directoriesChangedFrom:local];
+        if ([dirs count] == 0) {
+            return @[];
+        }
+        // Only compare the files in changed directories (unless there are too many to list as query
+        // parameters). Note that rtrim(path, replace(path, '/', '')) returns the path's directory,
+        // with a trailing slash; i.e. it trims all trailing characters up to the last slash.
+        if ([dirs count] <= MaxSyncDirectoryFilter) {
+            NSMutableArray *placeholders = [NSMutableArray new];
+            for (NSString *dir in dirs) {
+                [placeholders addObject:@"?"];
+                [params addObject:[dir length] > 0 ? [dir stringByAppendingString:@"/"] : @""];
+            }
+            dirFilter = [NSString stringWithFormat:@" AND rtrim(files.path, replace(files.path, '/', '')) IN (%@)",
+                         [placeholders componentsJoinedByString:@","]];
         }
-        if (responseCode == 200 || responseCode == 204) {
-            // Update the fileset's fingerprint.
-            [_fileDB performUpdate:@"UPDATE fingerprints SET previous=current WHERE category=?" withParams:@[ category ]];
+    }
+    // Note that files evicted from the content cache aren't synced; they're downloaded on demand.
+    NSString *sql = [NSString stringWithFormat:@"SELECT files.id, files.path, files.category, files.hash"
+                     " FROM files LEFT JOIN manifest ON files.path = manifest.path"
+                     " WHERE files.category=? AND files.status != 'packaged'%@"
+                     " AND (manifest.hash IS NULL OR manifest.hash != files.hash)"
+                     " AND files.path NOT IN (SELECT path FROM cache_entries WHERE evicted=1)"
+                     " LIMIT %ld", dirFilter, (long)limit];
+    return [_fileDB performQuery:sql withParams:params];
+}
+
+- (IFCMSMerkleTree *)expectedTreeForFileset:(NSString *)category {
+    NSArray *rs = [_fileDB performQuery:@"SELECT path, hash FROM merkle WHERE category=?" withParams:@[ category ]];
+    if ([rs count] > 0) {
+        NSMutableDictionary *hashes = [NSMutableDictionary new];
+        for (NSDictionary *row in rs) {
+            hashes[row[@"path"]] = row[@"hash"];
+        }
+        return [[IFCMSMerkleTree alloc] initWithDirectoryHashes:hashes];
+    }
+    rs = [_fileDB performQuery:@"SELECT path, hash FROM files WHERE category=? AND status != 'packaged'"
+                    withParams:@[ category ]];
+    NSMutableDictionary *hashes = [NSMutableDictionary new];
+    for (NSDictionary *row in rs) {
+        id hash = row[@"hash"];
+        if (![hash isKindOfClass:[NSString class]]) {
+            return nil;
         }
-        // Resolve empty list - no follow-on commands.
-        [_promise resolve:@[]];
+        hashes[row[@"path"]] = hash;
+    }
+    return [[IFCMSMerkleTree alloc] initWithFileHashes:hashes];
+}
+
+- (IFCMSMerkleTree *)localTreeForFileset:(NSString *)category {
+    NSArray *rs = [_fileDB performQuery:@"SELECT path, hash FROM merkle_local WHERE category=?" withParams:@[ category ]];
+    if ([rs count] == 0) {
+        return nil;
+    }
+    NSMutableDictionary *hashes = [NSMutableDictionary new];
+    for (NSDictionary *row in rs) {
+        hashes[row[@"path"]] = row[@"hash"];
+    }
+    return [[IFCMSMerkleTree alloc] initWithDirectoryHashes:hashes];
+}
+
+- (void)updateLocalTreeForFileset:(NSString *)category {
+    NSDictionary *manifest = [_fileDB manifestForFileset:category];
+    NSMutableDictionary *fileHashes = [NSMutableDictionary new];
+    for (NSString *path in manifest) {
+        fileHashes[path] = manifest[path][@"hash"];
+    }
+    IFCMSMerkleTree *tree = [[IFCMSMerkleTree alloc] initWithFileHashes:fileHashes];
+    [_fileDB performUpdate:@"DELETE FROM merkle_local WHERE category=?" withParams:@[ category ]];
+    NSDictionary *dirHashes = tree.directoryHashes;
+    for (NSString *path in dirHashes) {
+        NSString *nodeID = [NSString stringWithFormat:@"%@:%@", category, path];
+        [_fileDB performUpdate:@"INSERT OR REPLACE INTO merkle_local (id, category, path, hash) VALUES (?, ?, ?, ?)"
+                    withParams:@[ nodeID, category, path, dirHashes[path] ]];
+    }
+}
+
+- (NSArray *)prefetchCommands {
+    // Read posts received by the refresh, most recent first.
+    NSString *sql = [NSString stringWithFormat:@"SELECT posts.id, posts.body, posts.image, files.path"
+                     " FROM posts"
+                     " INNER JOIN refresh_files ON posts.id = refresh_files.id"
+                     " INNER JOIN files ON posts.id = files.id"
+                     " LEFT JOIN commits ON files.\"commit\" = commits.\"commit\""
+                     " ORDER BY commits.date DESC LIMIT %ld", (long)_prefetchLimit];
+    NSArray *posts = [_fileDB performQuery:sql withParams:@[]];
+    // Collect referenced file IDs and paths, in post order.
+    NSMutableOrderedSet *refs = [NSMutableOrderedSet new];
+    for (NSDictionary *post in posts) {
+        id image = post[@"image"];
+        if ([image isKindOfClass:[NSNumber class]]) {
+            [refs addObject:image];
+        }
+        id body = post[@"body"];
+        if ([body isKindOfClass:[NSString class]]) {
+            [refs addObjectsFromArray:[self filePathsReferencedByBody:body postPath:post[@"path"]]];
+        }
+        NSArray *meta = [_fileDB performQuery:@"SELECT value FROM meta WHERE fileid=?" withParams:@[ post[@"id"] ]];
+        for (NSDictionary *row in meta) {
+            id value = row[@"value"];
+            if ([value isKindOfClass:[NSString class]] && [value rangeOfString:@"/"].location != NSNotFound) {
+                [refs addObject:[value hasPrefix:@"/"] ? [value substringFromIndex:1] : value];
+            }
+        }
+    }
+    // Resolve references to file records.
+    NSMutableArray *commands = [NSMutableArray new];
+    NSString *command = [self qualifyName:@"prefetch-file"];
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSArray *refList = [refs array];
+    NSMutableSet *queued = [NSMutableSet new];
+    for (NSUInteger i = 0; i < [refList count] && (NSInteger)[commands count] < _prefetchLimit; i += MaxQueryParams) {
+        NSArray *batch = [refList subarrayWithRange:NSMakeRange(i, MIN((NSUInteger)MaxQueryParams, [refList count] - i))];
+        NSMutableArray *placeholders = [NSMutableArray new];
+        for (NSUInteger j = 0; j < [batch count]; j++) {
+            [placeholders addObject:@"?"];
+        }
+        NSString *list = [placeholders componentsJoinedByString:@","];
+        // Note that evicted files aren't prefetched; they're downloaded again only on demand.
+        NSString *fileSQL = [NSString stringWithFormat:@"SELECT id, path, category, status FROM files"
+                             " WHERE (path IN (%@) OR id IN (%@)) AND status != 'packaged'"
+                             " AND path NOT IN (SELECT path FROM cache_entries WHERE evicted=1)", list, list];
+        NSArray *files = [_fileDB performQuery:fileSQL withParams:[batch arrayByAddingObjectsFromArray:batch]];
+        // Order the files by their first reference.
+        NSMutableDictionary *filesByRef = [NSMutableDictionary new];
+        for (NSDictionary *file in files) {
+            filesByRef[file[@"path"]] = file;
+            filesByRef[file[@"id"]] = file;
+        }
+        for (id ref in batch) {
+            NSDictionary *file = filesByRef[ref];
+            if (!file || [queued containsObject:file[@"path"]] || (NSInteger)[commands count] >= _prefetchLimit) {
+                continue;
+            }
+            [queued addObject:file[@"path"]];
+            NSString *cachePath = [_fileDB cacheLocationForFile:file];
+            if (cachePath && ![fileManager fileExistsAtPath:cachePath]) {
+                [commands addObject:@{
+                    @"name":        command,
+                    @"args":        @[ file[@"path"] ],
+                    @"lane":        @"prefetch",
+                    @"priority":    @PrefetchPriority
+                }];
+            }
+        }
+    }
+    return commands;
+}
+
+- (NSArray *)filePathsReferencedByBody:(NSString *)body postPath:(NSString *)postPath {
+    static NSRegularExpression *LinkPattern;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        // Matches HTML src and href attribute values, and markdown link and image targets.
+        LinkPattern = [NSRegularExpression regularExpressionWithPattern:@"(?:src|href)\\s*=\\s*[\"']([^\"']+)[\"']|\\]\\(([^)\\s]+)"
+                                                                options:NSRegularExpressionCaseInsensitive
+                                                                  error:nil];
+    });
+    NSMutableArray *paths = [NSMutableArray new];
+    NSString *postDir = [postPath stringByDeletingLastPathComponent];
+    NSArray *matches = [LinkPattern matchesInString:body options:0 range:NSMakeRange(0, [body length])];
+    for (NSTextCheckingResult *match in matches) {
+        NSRange range = [match rangeAtIndex:1];
+        if (range.location == NSNotFound) {
+            range = [match rangeAtIndex:2];
+        }
+        NSString *link = [body substringWithRange:range];
+        // Use the path portion of absolute URLs, and discard any query or fragment.
+        NSURL *url = [NSURL URLWithString:link];
+        NSString *path = url.scheme ? url.path : [[link componentsSeparatedByCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"?#"]] firstObject];
+        path = [path stringByRemovingPercentEncoding] ?: path;
+        if ([path length] == 0) {
+            continue;
+        }
+        if ([path hasPrefix:@"/"]) {
+            [paths addObject:[path substringFromIndex:1]];
+        }
+        else {
+            // Could be relative to the post, or to the content root.
+            [paths addObject:[[postDir stringByAppendingPathComponent:path] stringByStandardizingPath]];
+            [paths addObject:path];
+        }
+    }
+    return paths;
+}
+
+- (QPromise *)prefetchFile:(NSArray *)args {
+
+    QPromise *promise = [QPromise new];
+
+    NSArray *rs = [_fileDB performQuery:@"SELECT * FROM files WHERE path=?" withParams:@[ args[0] ]];
+    NSDictionary *file = [rs count] > 0 ? rs[0] : nil;
+    NSString *cachePath = file ? [_fileDB cacheLocationForFile:file] : nil;
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    if (!cachePath || [fileManager fileExistsAtPath:cachePath]) {
+        // File deleted, not cachable, or already cached (e.g. by a fileset download or on demand).
+        [promise resolve:@[]];
+        return promise;
+    }
+    NSString *filesetPath = [_fileDB filesetLocationForFile:file];
+    IFCMSBlobStore *blobStore = _fileDB.blobStore;
+    IFCMSCacheManager *cacheManager = _fileDB.authority.cacheManager;
+    id hash = file[@"hash"];
+    if ([hash isKindOfClass:[NSString class]] && [blobStore hasBlob:hash] && [blobStore linkBlob:hash toPath:filesetPath]) {
+        // Same content already cached for another file.
+        [_fileDB updateManifestEntry:[blobStore manifestEntryForFileAtPath:filesetPath hash:hash] forFile:file];
+        [cacheManager addFile:file atPath:filesetPath];
+        [promise resolve:@[]];
+        return promise;
+    }
+    NSString *url = [_cms urlForFile:file[@"path"]];
+    [_httpClient getFile:url]
+    .then((id)^(IFHTTPClientResponse *response) {
+        NSString *downloadPath = [response.downloadLocation path];
+        // The download may be shared with a concurrent on-demand request which has already moved it.
+        if (response.httpResponse.statusCode == 200 && [fileManager fileExistsAtPath:downloadPath]) {
+            [fileManager createDirectoryAtPath:[filesetPath stringByDeletingLastPathComponent]
+                   withIntermediateDirectories:YES
+                                    attributes:nil
+                                         error:nil];
+            if (rename([downloadPath fileSystemRepresentation], [filesetPath fileSystemRepresentation]) == 0) {
+                NSString *fileHash = [blobStore addFileAtPath:filesetPath];
+                NSDictionary *entry = fileHash ? [blobStore manifestEntryForFileAtPath:filesetPath hash:fileHash] : nil;
+                // Other network commands may be running, so the file DB is only accessed on the
+                // command execution queue.
+                dispatch_async([IFCommandScheduler getCommandExecutionQueue], ^{
+                    [_fileDB updateManifestEntry:entry forFile:file];
+                    [cacheManager addFile:file atPath:filesetPath];
+                    [promise resolve:@[]];
+                });
+                return nil;
+            }
+        }
+        [promise resolve:@[]];
         return nil;
     })
     .fail(^(id error) {
-        NSString *msg = [NSString stringWithFormat:@"Fileset download from %@ failed: %@", filesetURL, error];
-        [_promise reject:msg];
+        NSString *msg = [NSString stringWithFormat:@"Prefetch of %@ failed: %@", url, error];
+        [promise reject:msg];
     });
 
     // Return deferred promise.
-    return _promise;
+    return promise;
+}
+
+// TODO: Test against a stub server, covering batch archives, filesets missing from the archive, and
+// the fallback to per-fileset downloads for 400/404/405/501 responses.
+- (QPromise *)downloadFilesets:(NSArray *)args {
+
+    // Note that a local promise is used, as fileset downloads may execute concurrently.
+    QPromise *promise = [QPromise new];
+
+    // Build the batch URL and query parameters; the 'since' commit for each fileset is passed as a
+    // since.{category} parameter.
+    NSString *filesetsURL = [_cms urlForFilesets];
+    NSMutableDictionary *data = [NSMutableDictionary new];
+    data[@"secure"] = IsSecure;
+    NSMutableArray *categories = [NSMutableArray new];
+    for (NSArray *filesetArgs in args) {
+        [categories addObject:filesetArgs[0]];
+        if ([filesetArgs count] > 2) {
+            data[[NSString stringWithFormat:@"since.%@", filesetArgs[0]]] = filesetArgs[2];
+        }
+    }
+    data[@"categories"] = [categories componentsJoinedByString:@","];
+
+    // The download is resumable, with any partial download kept in the staging directory. The
+    // resume file is named after the requested categories, so that a partial download is only
+    // resumed by a request for the same filesets.
+    NSString *stagingPath = [_fileDB.authority.stagingPath stringByAppendingPathComponent:@"filesets"];
+    NSString *batchName = [NSString stringWithFormat:@"batch-%@", [categories componentsJoinedByString:@"+"]];
+    NSString *resumePath = [stagingPath stringByAppendingPathComponent:[batchName stringByAppendingPathExtension:@"zip"]];
+    NSDictionary *options = @{
+        IFHTTPClientRequestOptionAcceptEncoding:    _acceptEncodings,
+        IFHTTPClientRequestOptionResumePath:        resumePath
+    };
+    // The file DB is only accessed on the command execution queue, as other network commands may be
+    // running; read the filesets' current manifests now, while on that queue.
+    dispatch_queue_t execQueue = [IFCommandScheduler getCommandExecutionQueue];
+    NSMutableDictionary *manifests = [NSMutableDictionary new];
+    if (_fileDB.blobStore) {
+        for (NSString *category in categories) {
+            manifests[category] = [_fileDB manifestForFileset:category];
+        }
+    }
+    [_httpClient getFile:filesetsURL data:data options:options]
+    .then((id)^(IFHTTPClientResponse *response) {
+        NSInteger responseCode = response.httpResponse.statusCode;
+        if (responseCode == 400 || responseCode == 404 || responseCode == 405 || responseCode == 501) {
+            // Batch requests not supported by the server; download the filesets separately.
+            dispatch_async(execQueue, ^{
+                _batchFilesetsUnsupported = YES;
+                [promise resolve:[self filesetDownloadCommands:args]];
+            });
+            return nil;
+        }
+        if (responseCode != 200) {
+            NSString *msg = [NSString stringWithFormat:@"Fileset batch download from %@ failed: HTTP %ld", filesetsURL, (long)responseCode];
+            [promise reject:msg];
+            return nil;
+        }
+        NSString *downloadPath = [self keepDownloadedFile:response withName:batchName];
+        if (!downloadPath) {
+            [promise reject:[NSString stringWithFormat:@"Failed to keep fileset batch download from %@", filesetsURL]];
+            return nil;
+        }
+        dispatch_async(_deployQueue, ^{
+            [self deployFilesets:args
+                  fromArchive:downloadPath
+                    batchName:batchName
+                    manifests:manifests
+                     response:response
+                      promise:promise];
+        });
+        return nil;
+    })
+    .fail(^(id error) {
+        NSString *msg = [NSString stringWithFormat:@"Fileset batch download from %@ failed: %@", filesetsURL, error];
+        [promise reject:msg];
+    });
+
+    // Return deferred promise.
+    return promise;
+}
+
+- (void)deployFilesets:(NSArray *)args
+           fromArchive:(NSString *)downloadPath
+             batchName:(NSString *)batchName
+             manifests:(NSDictionary *)manifests
+              response:(IFHTTPClientResponse *)response
+               promise:(QPromise *)promise {
+    // Extract the archive, and then deploy each fileset from its directory in the archive.
+    dispatch_queue_t execQueue = [IFCommandScheduler getCommandExecutionQueue];
+    NSString *stagingPath = [downloadPath stringByDeletingLastPathComponent];
+    NSString *extractPath = [stagingPath stringByAppendingPathComponent:[batchName stringByAppendingPathExtension:@"extract"]];
+    [[NSFileManager defaultManager] removeItemAtPath:extractPath error:nil];
+    NSError *error = nil;
+    BOOL extracted = [IFZipExtractor extractArchiveAtPath:downloadPath toPath:extractPath overwrite:YES error:&error];
+    [[NSFileManager defaultManager] removeItemAtPath:downloadPath error:nil];
+    if (!extracted) {
+        [self retireFilesetDirectory:extractPath];
+        NSString *msg = [NSString stringWithFormat:@"Fileset batch extraction failed: %@", error];
+        [promise reject:msg];
+        return;
+    }
+    NSMutableArray *missing = [NSMutableArray new];
+    NSMutableArray *failed = [NSMutableArray new];
+    NSMutableDictionary *published = [NSMutableDictionary new];
+    for (NSArray *filesetArgs in args) {
+        NSString *category = filesetArgs[0];
+        NSString *cachePath = filesetArgs[1];
+        NSString *filesetPath = [extractPath stringByAppendingPathComponent:category];
+        if (![[NSFileManager defaultManager] fileExistsAtPath:filesetPath]) {
+            // Fileset not included in the archive; download it separately.
+            [missing addObject:filesetArgs];
+            continue;
+        }
+        NSString *stagedPath = [self stageFileset:category fromPath:cachePath];
+        NSDictionary *manifest = nil;
+        if (stagedPath && [self mergeDirectory:filesetPath intoPath:stagedPath]) {
+            manifest = [self publishStagedFileset:stagedPath category:category toPath:cachePath previousManifest:manifests[category]];
+        }
+        if (manifest) {
+            published[category] = manifest;
+        }
+        else {
+            if (stagedPath) {
+                [self retireFilesetDirectory:stagedPath];
+            }
+            [failed addObject:category];
+        }
+    }
+    [self retireFilesetDirectory:extractPath];
+    dispatch_async(execQueue, ^{
+        // Record the filesets which were published, even if others failed.
+        for (NSArray *filesetArgs in args) {
+            NSString *category = filesetArgs[0];
+            if (published[category]) {
+                [self recordPublishedFileset:category atPath:filesetArgs[1] manifest:published[category]];
+                [self completeFilesetDownload:category response:response];
+            }
+        }
+        if ([failed count] > 0) {
+            NSString *msg = [NSString stringWithFormat:@"Failed to deploy filesets %@ from batch download", failed];
+            [promise reject:msg];
+        }
+        else {
+            [promise resolve:[self filesetDownloadCommands:missing]];
+        }
+    });
+}
+
+- (NSArray *)filesetDownloadCommands:(NSArray *)argsList {
+    NSString *command = [self qualifyName:@"download-fileset"];
+    NSMutableArray *commands = [NSMutableArray new];
+    for (NSArray *args in argsList) {
+        // Fileset downloads are network bound, and can run concurrently.
+        [commands addObject:@{ @"name": command, @"args": args, @"lane": @"network" }];
+    }
+    return commands;
+}
+
+- (BOOL)mergeDirectory:(NSString *)fromPath intoPath:(NSString *)toPath {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDirectoryEnumerator *files = [fileManager enumeratorAtPath:fromPath];
+    for (NSString *relPath in files) {
+        NSString *targetPath = [toPath stringByAppendingPathComponent:relPath];
+        if ([NSFileTypeDirectory isEqualToString:files.fileAttributes[NSFileType]]) {
+            if (![fileManager createDirectoryAtPath:targetPath withIntermediateDirectories:YES attributes:nil error:nil]) {
+                return NO;
+            }
+            continue;
+        }
+        // Rename the file over any existing copy; staging and extraction are on the same volume.
+        NSString *sourcePath = [fromPath stringByAppendingPathComponent:relPath];
+        if (rename([sourcePath fileSystemRepresentation], [targetPath fileSystemRepresentation]) != 0) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+- (void)completeFilesetDownload:(NSString *)category response:(IFHTTPClientResponse *)response {
+    NSInteger responseCode = response.httpResponse.statusCode;
+    // A 304 indicates that the fileset is unchanged since it was last downloaded.
+    if (responseCode == 200 || responseCode == 204 || responseCode == 304) {
+        // Update the fileset's fingerprint.
+        [_fileDB performUpdate:@"UPDATE fingerprints SET previous=current WHERE category=?" withParams:@[ category ]];
+    }
+}
+
+- (NSString *)keepDownloadedFile:(IFHTTPClientResponse *)response withName:(NSString *)name {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *stagingPath = [_fileDB.authority.stagingPath stringByAppendingPathComponent:@"filesets"];
+    NSString *keptPath = [stagingPath stringByAppendingPathComponent:[name stringByAppendingPathExtension:@"download"]];
+    [fileManager createDirectoryAtPath:stagingPath withIntermediateDirectories:YES attributes:nil error:nil];
+    [fileManager removeItemAtPath:keptPath error:nil];
+    if (![fileManager moveItemAtPath:[response.downloadLocation path] toPath:keptPath error:nil]) {
+        return nil;
+    }
+    return keptPath;
+}
+
+- (NSString *)stageFileset:(NSString *)category fromPath:(NSString *)cachePath {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *stagingPath = [_fileDB.authority.stagingPath stringByAppendingPathComponent:@"filesets"];
+    NSString *stagedPath = [stagingPath stringByAppendingPathComponent:[category stringByAppendingPathExtension:@"deploy"]];
+    // Discard any stale staging directory left by an interrupted deploy.
+    if ([fileManager fileExistsAtPath:stagedPath]) {
+        [self retireFilesetDirectory:stagedPath];
+    }
+    [fileManager createDirectoryAtPath:stagingPath withIntermediateDirectories:YES attributes:nil error:nil];
+    BOOL ok;
+    if ([fileManager fileExistsAtPath:cachePath]) {
+        // Clone the directory where possible (clonefile is only available from iOS 10.3, and only
+        // supported on APFS volumes); otherwise copy it.
+        ok = NO;
+        if (&clonefile != NULL) {
+            ok = clonefile([cachePath fileSystemRepresentation], [stagedPath fileSystemRepresentation], 0) == 0;
+        }
+        if (!ok) {
+            // Remove anything left by a failed clone before copying.
+            [fileManager removeItemAtPath:stagedPath error:nil];
+            ok = [fileManager copyItemAtPath:cachePath toPath:stagedPath error:nil];
+        }
+    }
+    else {
+        ok = [fileManager createDirectoryAtPath:stagedPath withIntermediateDirectories:YES attributes:nil error:nil];
+    }
+    return ok ? stagedPath : nil;
+}
+
+- (NSDictionary *)publishStagedFileset:(NSString *)stagedPath
+                              category:(NSString *)category
+                                toPath:(NSString *)cachePath
+                      previousManifest:(NSDictionary *)previousManifest {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    // Replace staged files with links to the blob store, adding new file contents as new blobs.
+    IFCMSBlobStore *blobStore = _fileDB.blobStore;
+    NSDictionary *manifest = @{};
+    if (blobStore) {
+        manifest = [blobStore addDirectoryAtPath:stagedPath manifest:previousManifest];
+    }
+    if (![fileManager fileExistsAtPath:cachePath]) {
+        // First deploy; simply move the staged directory into place.
+        [fileManager createDirectoryAtPath:[cachePath stringByDeletingLastPathComponent]
+               withIntermediateDirectories:YES
+                                attributes:nil
+                                     error:nil];
+        if (rename([stagedPath fileSystemRepresentation], [cachePath fileSystemRepresentation]) != 0) {
+            return nil;
+        }
+        return manifest;
+    }
+    // Atomically exchange the staged and current directories; the previous fileset is then left at
+    // the staged path. Note that renamex_np is only available from iOS 10.
+    BOOL swapped = NO;
+    if (&renamex_np != NULL) {
+        swapped = renamex_np([stagedPath fileSystemRepresentation], [cachePath fileSystemRepresentation], RENAME_SWAP) == 0;
+    }
+    if (!swapped) {
+        // The OS or file system doesn't support swaps; fall back to two renames, leaving a brief
+        // window in which the fileset is missing (but never partially deployed).
+        NSString *previousPath = [stagedPath stringByAppendingPathExtension:@"previous"];
+        if (rename([cachePath fileSystemRepresentation], [previousPath fileSystemRepresentation]) != 0) {
+            return nil;
+        }
+        if (rename([stagedPath fileSystemRepresentation], [cachePath fileSystemRepresentation]) != 0) {
+            // Restore the previous fileset.
+            rename([previousPath fileSystemRepresentation], [cachePath fileSystemRepresentation]);
+            return nil;
+        }
+        stagedPath = previousPath;
+    }
+    [self retireFilesetDirectory:stagedPath];
+    return manifest;
+}
+
+- (void)recordPublishedFileset:(NSString *)category atPath:(NSString *)cachePath manifest:(NSDictionary *)manifest {
+    if (_fileDB.blobStore) {
+        // Other running commands only access the file DB on the command execution queue, so the
+        // transaction can't interleave with their updates.
+        [_fileDB beginTransaction];
+        [_fileDB replaceManifest:manifest forFileset:category];
+        [self updateLocalTreeForFileset:category];
+        [_fileDB commitTransaction];
+    }
+    [_fileDB.authority.cacheManager addFileset:category atPath:cachePath];
+}
+
+- (void)retireFilesetDirectory:(NSString *)path {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *retiredPath = [_fileDB.authority.stagingPath stringByAppendingPathComponent:@"retired"];
+    [fileManager createDirectoryAtPath:retiredPath withIntermediateDirectories:YES attributes:nil error:nil];
+    // Move the directory out of the way, so that its path can be reused immediately.
+    NSString *retirePath = [retiredPath stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    if (![fileManager moveItemAtPath:path toPath:retirePath error:nil]) {
+        retirePath = path;
+    }
+    IFCMSBlobStore *blobStore = _fileDB.blobStore;
+    // Delete the directory on a background queue.
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        NSFileManager *fileManager = [NSFileManager new];
+        [fileManager removeItemAtPath:retirePath error:nil];
+        // Blobs only linked from the retired directory are no longer referenced.
+        [blobStore purgeUnreferencedBlobs];
+    });
+}
+
+- (void)purgeRetiredFilesetDirectories {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *retiredPath = [_fileDB.authority.stagingPath stringByAppendingPathComponent:@"retired"];
+    // List the directories now, so that directories retired after this point aren't included.
+    NSArray *names = [fileManager contentsOfDirectoryAtPath:retiredPath error:nil];
+    if ([names count] == 0) {
+        return;
+    }
+    IFCMSBlobStore *blobStore = _fileDB.blobStore;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        NSFileManager *fileManager = [NSFileManager new];
+        for (NSString *name in names) {
+            [fileManager removeItemAtPath:[retiredPath stringByAppendingPathComponent:name] error:nil];
+        }
+        [blobStore purgeUnreferencedBlobs];
+    });
+}
+
+- (QPromise *)purgeDeletedFiles:(NSArray *)args {
+    
+    QPromise *promise = [QPromise new];
+    
+    // Read the next batch of tombstones.
+    NSString *sql = [NSString stringWithFormat:@"SELECT path FROM tombstones LIMIT %d", TombstoneBatchSize];
+    NSArray *rs = [_fileDB performQuery:sql withParams:@[]];
+    if ([rs count] == 0) {
+        [promise resolve:@[]];
+        return promise;
+    }
+    NSArray *paths = [rs valueForKey:@"path"];
+    
+    // Delete the files on a background queue.
+    dispatch_queue_t execQueue = [IFCommandScheduler getCommandExecutionQueue];
+    IFCMSBlobStore *blobStore = _fileDB.blobStore;
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0), ^{
+        NSFileManager *fileManager = [NSFileManager new];
+        for (NSString *path in paths) {
+            // An error here normally means that the file doesn't exist, and can be ignored.
+            [fileManager removeItemAtPath:path error:nil];
+        }
+        [blobStore purgeUnreferencedBlobs];
+        // Tombstones are only removed once their files have been deleted, so that the batch is
+        // retried if the app is terminated part way through.
+        dispatch_async(execQueue, ^{
+            [_fileDB deleteIDs:paths fromTable:@"tombstones"];
+            NSArray *commands = @[];
+            if ([_fileDB countInTable:@"tombstones" where:@"1=1"] > 0) {
+                commands = @[ @{ @"name": [self qualifyName:@"purge-deleted-files"], @"args": @[], @"priority": @1 } ];
+            }
+            [promise resolve:commands];
+        });
+    });
+    
+    // Return deferred promise.
+    return promise;
 }
 
 @end
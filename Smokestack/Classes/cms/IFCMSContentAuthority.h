@@ -21,6 +21,8 @@
 #import "IFCMSFileDB.h"
 #import "IFCMSFilesetCategoryPathRoot.h"
 #import "IFCMSCommandProtocol.h"
+#import "IFCMSPathIndex.h"
+#import "IFCMSCacheManager.h"
 #import "IFCMSSettings.h"
 #import "IFCMSAuthenticationManager.h"
 #import "IFHTTPClient.h"
@@ -41,8 +43,36 @@
 @property (nonatomic, strong) NSDictionary *cms;
 /// The content refresh interval, in minutes.
 @property (nonatomic, assign) CGFloat refreshInterval;
+/// The maximum content refresh interval when backing off after refreshes with no changes, in minutes. Defaults to 15.
+@property (nonatomic, assign) CGFloat maxRefreshInterval;
 /// An action to be performed after a logout. e.g. after the server returns a 401.
 @property (nonatomic, strong) NSString *logoutAction;
+/// Whether to stream refresh updates into the file DB as they are downloaded. Defaults to NO.
+@property (nonatomic, assign) BOOL streamUpdates;
+/// Whether to extract fileset zips as they are downloaded. Defaults to NO.
+@property (nonatomic, assign) BOOL streamFilesets;
+/// The number of update records to apply per DB transaction during a refresh. Defaults to 0 (no limit).
+@property (nonatomic, assign) NSInteger refreshChunkSize;
+/// The maximum number of simultaneous connections to the CMS server. Defaults to 0 (use the HTTP client default).
+@property (nonatomic, assign) NSInteger maxConnectionsPerHost;
+/// Whether to send credentials with CMS requests before they are requested by the server. Defaults to NO.
+@property (nonatomic, assign) BOOL preemptiveAuthentication;
+/// The maximum sustained number of requests per second to the CMS server. Defaults to 0 (no limit).
+@property (nonatomic, assign) CGFloat maxRequestsPerSecond;
+/// The number of requests which can be made to the CMS server in a burst. Defaults to 0 (use the governor default).
+@property (nonatomic, assign) NSInteger requestBurstSize;
+/// The Accept-Encoding header value sent with refresh and fileset requests. Defaults to "br, gzip" from iOS 11, otherwise "gzip".
+@property (nonatomic, strong) NSString *acceptEncodings;
+/// Whether to store cached files in a content-addressed blob store, deduplicating identical files. Defaults to NO.
+@property (nonatomic, assign) BOOL deduplicateFiles;
+/// The maximum number of changed files in a fileset to download individually. Defaults to 0 (always download fileset zips).
+@property (nonatomic, assign) NSInteger fileSyncLimit;
+/// The maximum size of evictable files in the content cache, in megabytes. Defaults to 0 (no limit).
+@property (nonatomic, assign) NSInteger contentCacheBudget;
+/// The maximum number of files referenced by updated posts to prefetch after a refresh. Defaults to 0 (no prefetch).
+@property (nonatomic, assign) NSInteger prefetchLimit;
+/// Whether to download updated filesets in a single batch request. Defaults to NO.
+@property (nonatomic, assign) BOOL batchFilesets;
 
 @end
 
@@ -69,8 +99,92 @@
 @property (nonatomic, strong) NSDictionary *queryTypes;
 /// The authority's scheduled command protocol.
 @property (nonatomic, strong) IFCMSCommandProtocol *commandProtocol;
+/// An in-memory index of file paths in the file DB.
+@property (nonatomic, strong) IFCMSPathIndex *pathIndex;
+/// The content cache manager; nil if the content cache size isn't limited.
+@property (nonatomic, strong) IFCMSCacheManager *cacheManager;
 /// An action to be performed after a logout. e.g. after the server returns a 401.
 @property (nonatomic, strong) NSString *logoutAction;
+/// Whether to stream refresh updates into the file DB as they are downloaded.
+@property (nonatomic, assign) BOOL streamUpdates;
+/**
+ * Whether to extract fileset zips as they are downloaded.
+ * When YES, fileset zip entries are extracted into the staging directory as the zip's bytes
+ * arrive, without first writing the zip to a temporary file; note that streamed fileset
+ * downloads can't be resumed if interrupted.
+ */
+@property (nonatomic, assign) BOOL streamFilesets;
+/**
+ * The number of update records to apply per DB transaction during a refresh.
+ * When greater than zero, a refresh's updates are committed in chunks of this size, with
+ * progress checkpointed so that an interrupted refresh can resume where it left off.
+ */
+@property (nonatomic, assign) NSInteger refreshChunkSize;
+/// The maximum number of simultaneous connections to the CMS server; zero to use the HTTP client default.
+@property (nonatomic, assign) NSInteger maxConnectionsPerHost;
+/**
+ * Whether to send credentials with CMS requests before they are requested by the server.
+ * When YES, a Basic auth header for the active user is attached to each request, avoiding an
+ * authentication challenge round trip on protected requests.
+ */
+@property (nonatomic, assign) BOOL preemptiveAuthentication;
+/**
+ * The maximum sustained number of requests per second to the CMS server; zero for no limit.
+ * Requests are governed per host using a token bucket, so short bursts of up to requestBurstSize
+ * requests are allowed above this rate. Applies to all requests made by the authority, including
+ * scheduled command and on-demand file requests.
+ */
+@property (nonatomic, assign) CGFloat maxRequestsPerSecond;
+/// The number of requests which can be made to the CMS server in a burst; zero to use the governor default.
+@property (nonatomic, assign) NSInteger requestBurstSize;
+/**
+ * The Accept-Encoding header value sent with refresh and fileset requests.
+ * Encodings not decoded by the URL loading system (e.g. zstd, or br before iOS 11) also need a content
+ * decoder registered with the HTTP client; see IFHTTPClient registerContentDecoder:forEncoding:.
+ * Note that fileset downloads are resumable: an interrupted download resumes without content
+ * encoding, and a fileset download in an encoding not decoded by the URL loading system can't be
+ * resumed.
+ */
+@property (nonatomic, strong) NSString *acceptEncodings;
+/**
+ * Whether to store cached files in a content-addressed blob store.
+ * When YES, each distinct file content is stored once, under its SHA-256 hash, and hard linked
+ * into the fileset cache directories which use it; files with identical content in different
+ * filesets then share a single copy, and files whose content hash is already known are linked
+ * rather than downloaded.
+ */
+@property (nonatomic, assign) BOOL deduplicateFiles;
+/**
+ * The maximum number of changed files in an updated fileset to download individually.
+ * When a fileset is updated and no more than this number of its files have a content hash
+ * different from the copy in the cache, only those files are downloaded; larger change sets
+ * download the fileset zip. Requires deduplicateFiles, as the comparison is made against the
+ * blob store manifest. Zero to always download fileset zips.
+ */
+@property (nonatomic, assign) NSInteger fileSyncLimit;
+/**
+ * The maximum size of evictable files in the content cache, in megabytes; zero for no limit.
+ * Files in filesets using the content cache (and which aren't pinned) are evicted in least
+ * recently used order when the total size of cached files exceeds this limit, and are
+ * downloaded again on demand if requested.
+ */
+@property (nonatomic, assign) NSInteger contentCacheBudget;
+/**
+ * The maximum number of files referenced by updated posts to prefetch after a refresh.
+ * When greater than zero, files referenced by posts received in a refresh (by the post's image,
+ * by links in the post body, or by post meta values) which aren't yet cached are downloaded in
+ * the background, most recent posts first, so that they're available when the post is first
+ * viewed. Zero disables prefetching.
+ */
+@property (nonatomic, assign) NSInteger prefetchLimit;
+/**
+ * Whether to download updated filesets in a single batch request.
+ * When YES, and a refresh updates more than one fileset needing a zip download, a combined
+ * archive of all the filesets is requested from the CMS in a single request, saving a request
+ * round trip per fileset. Falls back to separate fileset requests if the CMS doesn't support
+ * batch requests. Batch downloads are resumable, but aren't extracted as they stream.
+ */
+@property (nonatomic, assign) BOOL batchFilesets;
 
 /**
  * Do a CMS login using the specified credentials.
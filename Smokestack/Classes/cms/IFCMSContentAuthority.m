@@ -38,7 +38,7 @@
     if (self) {
         self.fileDB = [[IFJSONObject alloc] initWithDictionary:@{
             @"name":    @"$dbName",
-            @"version": @1,
+            @"version": @9,
             @"tables": @{
                 @"files": @{
                     @"columns": @{
@@ -46,6 +46,7 @@
                         @"path":        @{ @"type": @"STRING" },
                         @"category":    @{ @"type": @"STRING" },
                         @"status":      @{ @"type": @"STRING" },
+                        @"hash":        @{ @"type": @"STRING",  @"since": @4 },
                         @"commit":      @{ @"type": @"STRING",  @"tag": @"version" }
                     }
                 },
@@ -76,6 +77,66 @@
                         @"commit":      @{ @"type": @"STRING",  @"tag": @"version" }
 
                     }
+                },
+                @"checkpoints": @{
+                    @"since": @2,
+                    @"columns": @{
+                        @"id":          @{ @"type": @"STRING",  @"tag": @"id" },
+                        @"commitid":    @{ @"type": @"STRING" },
+                        @"groupid":     @{ @"type": @"STRING" },
+                        @"categories":  @{ @"type": @"STRING" },
+                        @"rowcount":    @{ @"type": @"INTEGER" }
+                    }
+                },
+                @"refresh_files": @{
+                    @"since": @2,
+                    @"columns": @{
+                        @"id":          @{ @"type": @"INTEGER", @"tag": @"id", @"unique": @YES }
+                    }
+                },
+                @"tombstones": @{
+                    @"since": @3,
+                    @"columns": @{
+                        @"path":        @{ @"type": @"STRING",  @"tag": @"id", @"unique": @YES }
+                    }
+                },
+                @"manifest": @{
+                    @"since": @4,
+                    @"columns": @{
+                        @"path":        @{ @"type": @"STRING",  @"tag": @"id", @"unique": @YES },
+                        @"category":    @{ @"type": @"STRING" },
+                        @"hash":        @{ @"type": @"STRING" },
+                        @"size":        @{ @"type": @"INTEGER" },
+                        @"mtime":       @{ @"type": @"INTEGER" }
+                    }
+                },
+                @"merkle": @{
+                    @"since": @5,
+                    @"columns": @{
+                        @"id":          @{ @"type": @"STRING",  @"tag": @"id", @"format": @"{category}:{path}" },
+                        @"category":    @{ @"type": @"STRING" },
+                        @"path":        @{ @"type": @"STRING" },
+                        @"hash":        @{ @"type": @"STRING" }
+                    }
+                },
+                @"merkle_local": @{
+                    @"since": @5,
+                    @"columns": @{
+                        @"id":          @{ @"type": @"STRING",  @"tag": @"id", @"format": @"{category}:{path}" },
+                        @"category":    @{ @"type": @"STRING" },
+                        @"path":        @{ @"type": @"STRING" },
+                        @"hash":        @{ @"type": @"STRING" }
+                    }
+                },
+                @"cache_entries": @{
+                    @"since": @6,
+                    @"columns": @{
+                        @"path":        @{ @"type": @"STRING",  @"tag": @"id", @"unique": @YES },
+                        @"category":    @{ @"type": @"STRING" },
+                        @"size":        @{ @"type": @"INTEGER" },
+                        @"accessed":    @{ @"type": @"REAL" },
+                        @"evicted":     @{ @"type": @"INTEGER" }
+                    }
                 }
             },
             @"orm": @{
@@ -131,6 +192,8 @@
             }
         }];
         self.refreshInterval = 1.0f; // Refresh once per minute.
+        self.maxRefreshInterval = 15.0f; // Back off to once per 15 minutes while there are no changes.
+        self.acceptEncodings = [IFHTTPClient nativeAcceptEncodings];
     }
     return self;
 }
@@ -142,7 +205,21 @@
         @"fileDB":          _fileDB,
         @"cms":             _cms,
         @"pathRoots":       self.pathRoots,
-        @"refreshInterval": [NSNumber numberWithFloat:self.refreshInterval]
+        @"refreshInterval": [NSNumber numberWithFloat:self.refreshInterval],
+        @"maxRefreshInterval":[NSNumber numberWithFloat:self.maxRefreshInterval],
+        @"streamUpdates":   [NSNumber numberWithBool:self.streamUpdates],
+        @"streamFilesets":  [NSNumber numberWithBool:self.streamFilesets],
+        @"refreshChunkSize":[NSNumber numberWithInteger:self.refreshChunkSize],
+        @"maxConnectionsPerHost":[NSNumber numberWithInteger:self.maxConnectionsPerHost],
+        @"preemptiveAuthentication":[NSNumber numberWithBool:self.preemptiveAuthentication],
+        @"maxRequestsPerSecond":[NSNumber numberWithFloat:self.maxRequestsPerSecond],
+        @"requestBurstSize":[NSNumber numberWithInteger:self.requestBurstSize],
+        @"acceptEncodings": self.acceptEncodings,
+        @"deduplicateFiles":[NSNumber numberWithBool:self.deduplicateFiles],
+        @"fileSyncLimit":   [NSNumber numberWithInteger:self.fileSyncLimit],
+        @"contentCacheBudget":[NSNumber numberWithInteger:self.contentCacheBudget],
+        @"prefetchLimit":   [NSNumber numberWithInteger:self.prefetchLimit],
+        @"batchFilesets":   [NSNumber numberWithBool:self.batchFilesets]
     }];
     config = [config extendWithParameters:@{
         @"authorityName":   self.authorityName,
@@ -266,6 +343,8 @@
 #pragma mark - IFAbstractContentAuthority overrides
 
 - (void)refreshContent {
+    // Note that the command protocol reports completion of the refresh.
+    [self refreshDidStart];
     NSString *cmd = [NSString stringWithFormat:@"%@.refresh", self.authorityName];
     [self.provider.commandScheduler appendCommand:cmd];
     [self.provider.commandScheduler executeQueue];
@@ -282,13 +361,25 @@
     if (![root hasPrefix:@"~"]) {
         // Lookup file entry by path.
         NSString *filePath = [path fullPath];
-        NSArray *result = [_fileDB performQuery:@"SELECT id, category FROM files WHERE path=?"
-                                     withParams:@[ filePath ]];
-        if ([result count] > 0) {
+        id fileID = nil;
+        NSString *category = nil;
+        if (_pathIndex.loaded) {
+            IFCMSPathIndexEntry *entry = [_pathIndex entryForPath:filePath];
+            fileID = entry.fileID;
+            category = entry.category;
+        }
+        else {
+            // Path index not yet loaded; query the file DB.
+            NSArray *result = [_fileDB performQuery:@"SELECT id, category FROM files WHERE path=?"
+                                         withParams:@[ filePath ]];
+            if ([result count] > 0) {
+                NSDictionary *row = result[0];
+                fileID = row[@"id"];
+                category = row[@"category"];
+            }
+        }
+        if (fileID) {
             // File entry found in database; rewrite content path to a direct resource reference.
-            NSDictionary *row = result[0];
-            NSString *fileID = row[@"id"];
-            NSString *category = row[@"category"];
             NSString *resourcePath = [NSString stringWithFormat:@"~%@/$%@", category, fileID];
             NSString *ext = [path ext];
             if (ext) {
@@ -327,6 +418,34 @@
     [super startService];
     _authManager = [[IFCMSAuthenticationManager alloc] initWithCMSSettings:_cms];
     _httpClient = [[IFHTTPClient alloc] initWithNSURLSessionTaskDelegate:(id<NSURLSessionTaskDelegate>)_authManager];
+    if (_maxConnectionsPerHost > 0) {
+        _httpClient.maxConnectionsPerHost = _maxConnectionsPerHost;
+    }
+    if (_preemptiveAuthentication) {
+        _httpClient.authorizationProvider = _authManager;
+    }
+    // Govern request throughput to the CMS server; concurrency is limited to the connection limit, so
+    // that queued requests wait in the governor rather than timing out in the URL session.
+    IFHTTPRateGovernor *rateGovernor = [IFHTTPRateGovernor new];
+    rateGovernor.requestsPerSecond = _maxRequestsPerSecond;
+    if (_requestBurstSize > 0) {
+        rateGovernor.burstSize = _requestBurstSize;
+    }
+    rateGovernor.maxConcurrentRequestsPerHost = _httpClient.maxConnectionsPerHost;
+    _httpClient.rateGovernor = rateGovernor;
+    NSString *validatorsPath = [self.stagingPath stringByAppendingPathComponent:@"validators.plist"];
+    _httpClient.validatorStore = [[IFHTTPValidatorStore alloc] initWithPath:validatorsPath];
+    if (_deduplicateFiles) {
+        NSString *blobsPath = [self.contentCachePath stringByAppendingPathExtension:@"blobs"];
+        _fileDB.blobStore = [[IFCMSBlobStore alloc] initWithPath:blobsPath];
+    }
+    if (_contentCacheBudget > 0) {
+        _cacheManager = [[IFCMSCacheManager alloc] initWithFileDB:_fileDB];
+        _cacheManager.budget = (unsigned long long)_contentCacheBudget * 1024 * 1024;
+        [_cacheManager evictIfNeeded];
+    }
+    _pathIndex = [[IFCMSPathIndex alloc] initWithFileDB:_fileDB];
+    [_pathIndex reload];
     _commandProtocol = [[IFCMSCommandProtocol alloc] initWithAuthority:self];
     // Register command protocol with the scheduler, using the authority name as the command prefix.
     self.provider.commandScheduler.commands = @{ self.authorityName: _commandProtocol };
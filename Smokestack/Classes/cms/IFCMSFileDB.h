@@ -18,6 +18,7 @@
 
 #import "IFDB.h"
 #import "IFIOCTypeInspectable.h"
+#import "IFCMSBlobStore.h"
 
 @class IFCMSContentAuthority;
 
@@ -29,6 +30,12 @@
 @property (nonatomic, strong) NSDictionary *filesets;
 /// The name of the files table. Defaults to 'files'.
 @property (nonatomic, strong) NSString *filesTable;
+/**
+ * A content-addressed store of cached file contents; nil if files aren't deduplicated.
+ * When set, cached file locations are resolved through the manifest table, which records the
+ * content hash of each file deployed to a fileset cache directory.
+ */
+@property (nonatomic, strong) IFCMSBlobStore *blobStore;
 
 - (id)initWithContentAuthority:(IFCMSContentAuthority *)authority;
 - (id)initWithCMSFileDB:(IFCMSFileDB *)cmsFileDB;
@@ -46,15 +53,30 @@
 - (NSString *)cacheLocationForFileset:(NSString *)category;
 /**
  * Return the absolute path for the cache location of the specified file record.
+ * If the file is recorded in the blob store manifest then the location of its blob is returned.
  * Returns nil if the file isn't locally cachable.
  */
 - (NSString *)cacheLocationForFile:(NSDictionary *)fileRecord;
+/**
+ * Return the absolute path of the specified file record's location within its fileset's cache
+ * directory, without resolving through the blob store manifest. This is the location that a
+ * downloaded copy of the file should be written to, or deleted from.
+ * Returns nil if the file isn't locally cachable.
+ */
+- (NSString *)filesetLocationForFile:(NSDictionary *)fileRecord;
 /**
  * Return the absolute path for the cache location of the file with the specified path.
  * Returns nil if the file isn't locally cachable.
  */
 - (NSString *)cacheLocationForFileWithPath:(NSString *)path;
 
+/// Return the blob store manifest for a fileset category, as a map of file paths to manifest entries.
+- (NSDictionary *)manifestForFileset:(NSString *)category;
+/// Replace the blob store manifest for a fileset category with the specified manifest entries.
+- (BOOL)replaceManifest:(NSDictionary *)manifest forFileset:(NSString *)category;
+/// Add or update the blob store manifest entry for a single file.
+- (BOOL)updateManifestEntry:(NSDictionary *)entry forFile:(NSDictionary *)fileRecord;
+
 /// Return a new instance of this database.
 - (IFCMSFileDB *)newInstance;
 
@@ -36,6 +36,7 @@
         _authority = cmsFileDB.authority;
         _filesTable = cmsFileDB.filesTable;
         _filesets= cmsFileDB.filesets;
+        _blobStore = cmsFileDB.blobStore;
     }
     return self;
 }
@@ -119,9 +120,28 @@
     return path;
 }
 
+- (NSString *)cacheLocationForFile:(NSDictionary *)fileRecord {
+    if (_blobStore && fileRecord[@"path"] && fileRecord[@"category"]
+        && ![@"packaged" isEqualToString:fileRecord[@"status"]]) {
+        // Resolve the file through the manifest. The manifest entry is ignored if the file record
+        // has a content hash which doesn't match, i.e. the file has been updated since it was cached.
+        // Manifest paths are unique; the migration to schema version 8 kept the most recent of any
+        // duplicate entries, and the most recent entry is read here to match.
+        NSArray *rs = [self performQuery:@"SELECT hash FROM manifest WHERE path=? AND category=? ORDER BY rowid DESC LIMIT 1"
+                              withParams:@[ fileRecord[@"path"], fileRecord[@"category"] ]];
+        NSString *hash = [rs count] > 0 ? rs[0][@"hash"] : nil;
+        id fileHash = fileRecord[@"hash"];
+        BOOL current = ![fileHash isKindOfClass:[NSString class]] || [fileHash isEqualToString:hash];
+        if (hash && current && [_blobStore hasBlob:hash]) {
+            return [_blobStore pathForBlob:hash];
+        }
+    }
+    return [self filesetLocationForFile:fileRecord];
+}
+
 // TODO: Consider breaking the following method into two; strictly speaking, the cache location
 // should be writeable, but if content is packaged then its cache location isn't writeable.
-- (NSString *)cacheLocationForFile:(NSDictionary *)fileRecord {
+- (NSString *)filesetLocationForFile:(NSDictionary *)fileRecord {
     NSString *path = nil;
     NSString *status = fileRecord[@"status"];
     NSString *category = fileRecord[@"category"];
@@ -146,6 +166,42 @@
     return [rs count] > 0 ? [self cacheLocationForFile:rs[0]] : nil;
 }
 
+- (NSDictionary *)manifestForFileset:(NSString *)category {
+    // Rows are read in insertion order, so that the most recent entry for a path is the one kept.
+    NSArray *rs = [self performQuery:@"SELECT path, hash, size, mtime FROM manifest WHERE category=? ORDER BY rowid"
+                          withParams:@[ category ]];
+    NSMutableDictionary *manifest = [NSMutableDictionary new];
+    for (NSDictionary *row in rs) {
+        manifest[row[@"path"]] = row;
+    }
+    return manifest;
+}
+
+- (BOOL)replaceManifest:(NSDictionary *)manifest forFileset:(NSString *)category {
+    // Note that no transaction is used here; callers which need the replacement to be atomic should
+    // wrap it in a transaction. An incomplete manifest only means that some files are hashed again
+    // on the next deploy.
+    BOOL ok = [self performUpdate:@"DELETE FROM manifest WHERE category=?" withParams:@[ category ]];
+    for (NSString *path in [manifest keyEnumerator]) {
+        if (!ok) {
+            break;
+        }
+        NSDictionary *entry = manifest[path];
+        ok = [self performUpdate:@"INSERT OR REPLACE INTO manifest (path, category, hash, size, mtime) VALUES (?, ?, ?, ?, ?)"
+                      withParams:@[ path, category, entry[@"hash"], entry[@"size"], entry[@"mtime"] ]];
+    }
+    return ok;
+}
+
+- (BOOL)updateManifestEntry:(NSDictionary *)entry forFile:(NSDictionary *)fileRecord {
+    if (!entry) {
+        return NO;
+    }
+    // Note that manifest paths have a unique index, so this replaces any previous entry for the file.
+    return [self performUpdate:@"INSERT OR REPLACE INTO manifest (path, category, hash, size, mtime) VALUES (?, ?, ?, ?, ?)"
+                    withParams:@[ fileRecord[@"path"], fileRecord[@"category"], entry[@"hash"], entry[@"size"], entry[@"mtime"] ]];
+}
+
 - (IFCMSFileDB *)newInstance {
     IFCMSFileDB *db = [[IFCMSFileDB alloc] initWithCMSFileDB:self];
     [db startService];
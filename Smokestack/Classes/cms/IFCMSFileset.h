@@ -42,6 +42,12 @@
 @property (nonatomic, strong) NSString *category;
 /** A flag indicating whether a fileset's content should be downloaded and cached. */
 @property (nonatomic, assign) BOOL cachable;
+/**
+ * A flag indicating whether a fileset's cached content is exempt from eviction by the content
+ * cache manager. Only applies to filesets using the content cache; app cache content is never
+ * evicted.
+ */
+@property (nonatomic, assign) BOOL pinned;
 
 /// Get the path of the cache location for this fileset.
 - (NSString *)cachePath:(IFCMSContentAuthority *)authority;
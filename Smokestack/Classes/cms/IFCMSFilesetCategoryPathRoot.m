@@ -108,23 +108,42 @@
                 NSString *url = [_authority.cms urlForFile:path];
                 NSString *cachePath = [_fileDB cacheLocationForFile:content];
                 BOOL cachable = [self.fileset cachable];
+                IFCMSBlobStore *blobStore = _fileDB.blobStore;
+                id hash = content[@"hash"];
                 // Check if a local copy of the file exists in the cache.
                 if (cachable && [[NSFileManager defaultManager] fileExistsAtPath:cachePath]) {
                     // Local copy found, respond with contents.
+                    [_authority.cacheManager recordAccessToFile:content];
                     [response respondWithFileData:cachePath
                                          mimeType:mimeType
                                       cachePolicy:NSURLCacheStorageNotAllowed];
                 }
+                else if (cachable && [hash isKindOfClass:[NSString class]] && [blobStore hasBlob:hash]
+                         && [blobStore linkBlob:hash toPath:[_fileDB filesetLocationForFile:content]]) {
+                    // Same content already cached for another file; link to it instead of downloading.
+                    NSString *filesetPath = [_fileDB filesetLocationForFile:content];
+                    [_fileDB updateManifestEntry:[blobStore manifestEntryForFileAtPath:filesetPath hash:hash]
+                                         forFile:content];
+                    [_authority.cacheManager addFile:content atPath:filesetPath];
+                    [response respondWithFileData:filesetPath
+                                         mimeType:mimeType
+                                      cachePolicy:NSURLCacheStorageNotAllowed];
+                }
                 else {
+                    // Downloads are written to the file's location in the fileset cache directory.
+                    cachePath = [_fileDB filesetLocationForFile:content];
                     // No local copy found, download from server.
                     IFHTTPClient *httpClient = _authority.httpClient;
                     [httpClient getFile:url]
                     .then((id)^(IFHTTPClientResponse *httpResponse) {
                         NSString *downloadPath = [httpResponse.downloadLocation path];
                         NSError *error = nil;
-                        // If cachable then move file to cache.
-                        if (cachable) {
-                            NSFileManager *fileManager = [NSFileManager defaultManager];
+                        NSFileManager *fileManager = [NSFileManager defaultManager];
+                        // If cachable then move file to cache. Note that the download may be shared
+                        // with a concurrent request for the same file which has already moved it.
+                        BOOL alreadyCached = ![fileManager fileExistsAtPath:downloadPath]
+                                          && [fileManager fileExistsAtPath:cachePath];
+                        if (cachable && !alreadyCached) {
                             // Ensure that the target directory exists.
                             NSString *cacheDir = [cachePath stringByDeletingLastPathComponent];
                             [fileManager createDirectoryAtPath:cacheDir
@@ -136,6 +155,16 @@
                                                      toPath:cachePath
                                                       error:&error];
                             }
+                            // Add the downloaded file to the blob store.
+                            NSString *fileHash = error ? nil : [blobStore addFileAtPath:cachePath];
+                            if (fileHash) {
+                                [_fileDB updateManifestEntry:[blobStore manifestEntryForFileAtPath:cachePath hash:fileHash]
+                                                     forFile:content];
+                            }
+                            // Record the file with the cache manager; this clears any eviction mark.
+                            if (!error) {
+                                [_authority.cacheManager addFile:content atPath:cachePath];
+                            }
                         }
                         if (error) {
                             [response respondWithError:error];
@@ -0,0 +1,56 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * A Merkle tree of the directories in a fileset.
+ * Each directory's hash is the SHA-256 hash of a listing of its entries, sorted by name in literal
+ * character order, with one line per entry in the form "{name}:{hash}\n"; file entries use the
+ * file's content hash, and directory entries use the directory name with a trailing slash and the
+ * directory's hash. The root directory has an empty path, and other directories are identified by
+ * their path relative to the root, e.g. "posts/images". Two trees with the same root hash describe
+ * the same files.
+ */
+@interface IFCMSMerkleTree : NSObject {
+    /// A map of directory paths to the paths of their sub-directories.
+    NSMutableDictionary *_children;
+}
+
+/// Initialize a tree by calculating directory hashes from a map of file paths to content hashes.
+- (id)initWithFileHashes:(NSDictionary *)fileHashes;
+/// Initialize a tree from a map of directory paths to previously calculated directory hashes.
+- (id)initWithDirectoryHashes:(NSDictionary *)directoryHashes;
+
+/// A map of directory paths to directory hashes.
+@property (nonatomic, strong, readonly) NSDictionary *directoryHashes;
+/// The hash of the root directory.
+@property (nonatomic, readonly) NSString *rootHash;
+
+/**
+ * Return the paths of directories whose hash differs from the same directory in another tree.
+ * Descends from the root only into sub-directories whose hash differs; unchanged sub-trees are
+ * skipped with a single comparison. The result includes directories missing from the other tree.
+ */
+- (NSArray *)directoriesChangedFrom:(IFCMSMerkleTree *)other;
+
+/// Return the parent directory path for a file or directory path; the root's path is empty.
++ (NSString *)directoryForPath:(NSString *)path;
+
+@end
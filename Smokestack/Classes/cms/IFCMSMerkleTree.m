@@ -0,0 +1,150 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import "IFCMSMerkleTree.h"
+#import <CommonCrypto/CommonDigest.h>
+
+@interface IFCMSMerkleTree ()
+
+/// Index the sub-directories of each directory in the tree.
+- (void)indexChildren;
+/// Add a directory and its changed sub-directories to a list of changed directories.
+- (void)addDirectory:(NSString *)path changedFrom:(IFCMSMerkleTree *)other toList:(NSMutableArray *)changed;
+/// Return the SHA-256 hash of a directory listing.
++ (NSString *)hashForEntries:(NSDictionary *)entries;
+
+@end
+
+@implementation IFCMSMerkleTree
+
+- (id)initWithFileHashes:(NSDictionary *)fileHashes {
+    self = [super init];
+    if (self) {
+        // Build a listing of the entries in each directory, with the files in each directory.
+        NSMutableDictionary *listings = [NSMutableDictionary new];
+        listings[@""] = [NSMutableDictionary new];
+        for (NSString *path in fileHashes) {
+            NSString *dir = [IFCMSMerkleTree directoryForPath:path];
+            NSMutableDictionary *listing = listings[dir];
+            if (!listing) {
+                listing = listings[dir] = [NSMutableDictionary new];
+                // Ensure that all ancestor directories have a listing.
+                for (NSString *ancestor = dir; [ancestor length] > 0;) {
+                    ancestor = [IFCMSMerkleTree directoryForPath:ancestor];
+                    if (listings[ancestor]) {
+                        break;
+                    }
+                    listings[ancestor] = [NSMutableDictionary new];
+                }
+            }
+            listing[[path lastPathComponent]] = fileHashes[path];
+        }
+        // Hash the directories, deepest first, so that each directory's sub-directory hashes are
+        // known by the time it is hashed.
+        NSArray *dirs = [[listings allKeys] sortedArrayUsingComparator:^NSComparisonResult(NSString *a, NSString *b) {
+            NSUInteger da = [[a pathComponents] count], db = [[b pathComponents] count];
+            return da > db ? NSOrderedAscending : (da < db ? NSOrderedDescending : NSOrderedSame);
+        }];
+        NSMutableDictionary *hashes = [NSMutableDictionary new];
+        for (NSString *dir in dirs) {
+            NSString *hash = [IFCMSMerkleTree hashForEntries:listings[dir]];
+            hashes[dir] = hash;
+            if ([dir length] > 0) {
+                NSString *name = [[dir lastPathComponent] stringByAppendingString:@"/"];
+                listings[[IFCMSMerkleTree directoryForPath:dir]][name] = hash;
+            }
+        }
+        _directoryHashes = hashes;
+        [self indexChildren];
+    }
+    return self;
+}
+
+- (id)initWithDirectoryHashes:(NSDictionary *)directoryHashes {
+    self = [super init];
+    if (self) {
+        _directoryHashes = directoryHashes;
+        [self indexChildren];
+    }
+    return self;
+}
+
+- (NSString *)rootHash {
+    return _directoryHashes[@""];
+}
+
+- (NSArray *)directoriesChangedFrom:(IFCMSMerkleTree *)other {
+    NSMutableArray *changed = [NSMutableArray new];
+    [self addDirectory:@"" changedFrom:other toList:changed];
+    return changed;
+}
+
++ (NSString *)directoryForPath:(NSString *)path {
+    NSRange range = [path rangeOfString:@"/" options:NSBackwardsSearch];
+    return range.location == NSNotFound ? @"" : [path substringToIndex:range.location];
+}
+
+#pragma mark - Private
+
+- (void)indexChildren {
+    _children = [NSMutableDictionary new];
+    for (NSString *dir in _directoryHashes) {
+        if ([dir length] > 0) {
+            NSString *parent = [IFCMSMerkleTree directoryForPath:dir];
+            NSMutableArray *children = _children[parent];
+            if (!children) {
+                children = _children[parent] = [NSMutableArray new];
+            }
+            [children addObject:dir];
+        }
+    }
+}
+
+- (void)addDirectory:(NSString *)path changedFrom:(IFCMSMerkleTree *)other toList:(NSMutableArray *)changed {
+    NSString *hash = _directoryHashes[path];
+    if (hash && [hash isEqualToString:other.directoryHashes[path]]) {
+        // Sub-tree unchanged.
+        return;
+    }
+    [changed addObject:path];
+    for (NSString *child in _children[path]) {
+        [self addDirectory:child changedFrom:other toList:changed];
+    }
+}
+
++ (NSString *)hashForEntries:(NSDictionary *)entries {
+    CC_SHA256_CTX ctx;
+    CC_SHA256_Init(&ctx);
+    NSArray *names = [[entries allKeys] sortedArrayUsingComparator:^NSComparisonResult(NSString *a, NSString *b) {
+        return [a compare:b options:NSLiteralSearch];
+    }];
+    for (NSString *name in names) {
+        NSData *line = [[NSString stringWithFormat:@"%@:%@\n", name, entries[name]] dataUsingEncoding:NSUTF8StringEncoding];
+        CC_SHA256_Update(&ctx, [line bytes], (CC_LONG)[line length]);
+    }
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &ctx);
+    NSMutableString *hash = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    for (NSInteger i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+        [hash appendFormat:@"%02x", digest[i]];
+    }
+    return hash;
+}
+
+@end
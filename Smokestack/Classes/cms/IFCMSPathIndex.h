@@ -0,0 +1,65 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import <Foundation/Foundation.h>
+#import "IFCMSFileDB.h"
+
+/// An entry in the file path index.
+@interface IFCMSPathIndexEntry : NSObject
+
+- (id)initWithFileID:(id)fileID category:(NSString *)category;
+
+/// The file's ID.
+@property (nonatomic, strong, readonly) id fileID;
+/// The file's fileset category.
+@property (nonatomic, strong, readonly) NSString *category;
+
+@end
+
+/**
+ * An in-memory index of file paths in the file DB.
+ * Maps each file's path to its file ID and fileset category, allowing content paths to be
+ * resolved without a DB query. The index is loaded in the background, and is replaced as a
+ * whole each time it is reloaded, so lookups can be made from any thread.
+ */
+@interface IFCMSPathIndex : NSObject {
+    /// The file DB the index is loaded from.
+    IFCMSFileDB *_fileDB;
+    /// A serial queue used to load the index.
+    dispatch_queue_t _loadQueue;
+}
+
+- (id)initWithFileDB:(IFCMSFileDB *)fileDB;
+
+/// Flag indicating whether the index has been loaded.
+@property (atomic, assign, readonly) BOOL loaded;
+/// The number of paths in the index.
+@property (nonatomic, assign, readonly) NSUInteger count;
+/**
+ * The approximate memory used by the index, in bytes.
+ * Includes the index keys and entries and the hash table used to store them.
+ */
+@property (atomic, assign, readonly) NSUInteger memoryFootprint;
+
+/// Reload the index from the file DB. The load is performed on a background queue.
+- (void)reload;
+/// Return the index entry for a file path, or nil if the path isn't in the index.
+- (IFCMSPathIndexEntry *)entryForPath:(NSString *)path;
+
+@end
@@ -0,0 +1,117 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import "IFCMSPathIndex.h"
+#import "IFLogger.h"
+#import <malloc/malloc.h>
+
+static IFLogger *Logger;
+
+/// Return the size of the heap allocation for an object; zero for tagged pointer values.
+#define AllocSize(obj)  (malloc_size((__bridge const void *)(obj)))
+
+@implementation IFCMSPathIndexEntry
+
+- (id)initWithFileID:(id)fileID category:(NSString *)category {
+    self = [super init];
+    if (self) {
+        _fileID = fileID;
+        _category = category;
+    }
+    return self;
+}
+
+@end
+
+@interface IFCMSPathIndex ()
+
+/// The index, mapping file paths to index entries.
+@property (atomic, strong) NSDictionary *entries;
+@property (atomic, assign) BOOL loaded;
+@property (atomic, assign) NSUInteger memoryFootprint;
+
+/// Read the index from the file DB.
+- (void)load;
+
+@end
+
+@implementation IFCMSPathIndex
+
++ (void)initialize {
+    Logger = [[IFLogger alloc] initWithTag:@"IFCMSPathIndex"];
+}
+
+- (id)initWithFileDB:(IFCMSFileDB *)fileDB {
+    self = [super init];
+    if (self) {
+        // Use a copy of the file DB to avoid problems with multi-thread access.
+        _fileDB = [fileDB newInstance];
+        _loadQueue = dispatch_queue_create("com.innerfunction.semo.cms.PathIndex", DISPATCH_QUEUE_SERIAL);
+        self.entries = @{};
+    }
+    return self;
+}
+
+- (NSUInteger)count {
+    return [self.entries count];
+}
+
+- (void)reload {
+    dispatch_async(_loadQueue, ^{
+        [self load];
+    });
+}
+
+- (void)load {
+    NSArray *rs = [_fileDB performQuery:@"SELECT id, path, category FROM files" withParams:@[]];
+    NSMutableDictionary *entries = [[NSMutableDictionary alloc] initWithCapacity:[rs count]];
+    // Category names are shared between all entries in the same category.
+    NSMutableDictionary *categories = [NSMutableDictionary new];
+    NSUInteger footprint = 0;
+    for (NSDictionary *row in rs) {
+        NSString *path = row[@"path"];
+        id fileID = row[@"id"];
+        NSString *category = row[@"category"];
+        if (!(path && fileID && category)) {
+            continue;
+        }
+        NSString *sharedCategory = categories[category];
+        if (!sharedCategory) {
+            sharedCategory = category;
+            categories[category] = category;
+            footprint += AllocSize(category);
+        }
+        IFCMSPathIndexEntry *entry = [[IFCMSPathIndexEntry alloc] initWithFileID:fileID category:sharedCategory];
+        entries[path] = entry;
+        footprint += AllocSize(path) + AllocSize(fileID) + AllocSize(entry);
+    }
+    // Add an estimate of the hash table size; one key and one value pointer per slot, assuming
+    // a load factor of around 75%.
+    footprint += ([entries count] * 2 * sizeof(id) * 4) / 3;
+    self.entries = entries;
+    self.memoryFootprint = footprint;
+    self.loaded = YES;
+    [Logger info:@"Loaded %lu paths, approx. %lu bytes", (unsigned long)[entries count], (unsigned long)footprint];
+}
+
+- (IFCMSPathIndexEntry *)entryForPath:(NSString *)path {
+    return self.entries[path];
+}
+
+@end
@@ -43,6 +43,8 @@
 - (NSString *)urlForUpdates;
 /// Return the URL for downloading a fileset of the specified category.
 - (NSString *)urlForFileset:(NSString *)category;
+/// Return the URL for downloading a combined archive of several filesets.
+- (NSString *)urlForFilesets;
 /// Return the URL for downloading a file at the specified path.
 - (NSString *)urlForFile:(NSString *)path;
 // Get the API's base URL. Used as the HTTP authentication protection space.
@@ -61,6 +61,10 @@
     return [self urlForPath:[self pathForResource:@"filesets" trailing:category]];
 }
 
+- (NSString *)urlForFilesets {
+    return [self urlForPath:[self pathForResource:@"filesets" trailing:nil]];
+}
+
 - (NSString *)urlForFile:(NSString *)path {
     return [self urlForPath:[self pathForResource:@"files" trailing:path]];
 }
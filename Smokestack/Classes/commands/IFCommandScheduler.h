@@ -24,10 +24,12 @@
 @interface IFCommandScheduler : NSObject <IFService> {
     // The queue database.
     IFDB *_db;
+    // A list of commands waiting to be executed.
+    NSMutableArray *_execQueue;
     // A list of commands currently being executed.
-    NSArray *_execQueue;
-    // Pointer into the exec queue to the command currently being executed.
-    NSInteger _execIdx;
+    NSMutableArray *_runningCommands;
+    // Flag indicating whether the queue is currently being processed.
+    BOOL _processing;
     // Current batch number.
     NSInteger _currentBatch;
 }
@@ -49,6 +51,18 @@
  * this mode is primarily useful for debugging.
  */
 @property (nonatomic, assign) BOOL deleteExecutedQueueRecords;
+/**
+ * A map of lane names to the number of commands in each lane which can execute concurrently.
+ * Commands are assigned to a lane by including a 'lane' value in the command item returned by
+ * the command which queues them; commands without a lane are serial, and only execute when no
+ * other command is running. Commands in the same lane and batch can execute concurrently, up to
+ * the lane's width; lanes not listed here have a width of 1. Defaults to { network: 4 }.
+ * A command item may also include a 'depends' list of command names; the command won't start
+ * until all preceding commands in its batch with those names have completed.
+ * This allows e.g. network bound commands to run concurrently while DB mutating commands remain
+ * serialized. Batches always complete in order.
+ */
+@property (nonatomic, strong) NSDictionary *laneWidths;
 
 /** Execute all commands currently on the queue. */
 - (void)executeQueue;
@@ -51,6 +51,8 @@ static dispatch_queue_t execQueue;
 @property (nonatomic, strong) NSArray *args;
 @property (nonatomic, strong) NSNumber *priority;
 @property (nonatomic, assign) NSInteger batch;
+@property (nonatomic, strong) NSString *lane;
+@property (nonatomic, strong) NSArray *depends;
 @property (nonatomic, strong) QPromise *promise;
 
 - (id)initFromRow:(NSDictionary *)row;
@@ -68,6 +70,11 @@ static dispatch_queue_t execQueue;
         NSString *argsJSON = row[@"args"];
         self.args = [argsJSON parseJSON:nil];
         self.batch = [(NSNumber *)row [@"batch"] integerValue];
+        self.lane = row[@"lane"];
+        NSString *dependsJSON = row[@"depends"];
+        if (dependsJSON) {
+            self.depends = [dependsJSON parseJSON:nil];
+        }
     }
     return self;
 }
@@ -88,10 +95,25 @@ static dispatch_queue_t execQueue;
 
 /** Refresh the exec queue by loading commands from the database. */
 - (void)refreshExecQueue;
-/** Execute the next command on the exec queue. */
+/** Start all commands on the exec queue which are ready to execute. */
 - (void)executeNextCommand;
-/** Continue queue processing after execution a command. */
-- (void)continueQueueProcessingAfterCommand:(IFCommandItem *)commandItem;
+/**
+ * Return the next command on the exec queue which is ready to execute, or nil if none are ready.
+ * A command is ready if:
+ * - It belongs to the same batch as all currently running commands;
+ * - It is a serial command (i.e. has no lane), is at the head of the queue and no other
+ *   commands are running;
+ * - Or it is a lane command, no serial command precedes it on the queue, its lane isn't
+ *   already running at full width, and none of the commands it depends on precede it or
+ *   are still running.
+ */
+- (IFCommandItem *)nextReadyCommand;
+/** Return the number of commands which can run concurrently in a lane. */
+- (NSInteger)widthOfLane:(NSString *)lane;
+/** Start executing a command. */
+- (void)startCommand:(IFCommandItem *)commandItem;
+/** Queue a command's follow up commands and remove it from the queue, after it has completed. */
+- (void)completeCommand:(IFCommandItem *)commandItem withCommands:(NSArray *)commands;
 /**
  * Parse a command item into a command descriptor.
  * The command item can be either:
@@ -125,7 +147,7 @@ static void *execQueueKey = "IFCommandScheduler.execQueue";
         // Command database setup.
         _db = [[IFDB alloc] init];
         _db.name = @"com.innerfunction.semo.command-scheduler";
-        _db.version = @1;
+        _db.version = @2;
         _db.tables = @{
             @"queue": @{
                 @"columns": @{
@@ -133,11 +155,18 @@ static void *execQueueKey = "IFCommandScheduler.execQueue";
                     @"batch":   @{ @"type": @"INTEGER" },
                     @"command": @{ @"type": @"TEXT" },
                     @"args":    @{ @"type": @"TEXT" },
-                    @"status":  @{ @"type": @"TEXT" } // States: P - pending X - executed
+                    @"status":  @{ @"type": @"TEXT" }, // States: P - pending X - executed
+                    @"lane":    @{ @"type": @"TEXT", @"since": @2 },
+                    @"depends": @{ @"type": @"TEXT", @"since": @2 }
                 }
             }
         };
         _currentBatch = 0;
+        _execQueue = [NSMutableArray new];
+        _runningCommands = [NSMutableArray new];
+        
+        // Lane widths.
+        self.laneWidths = @{ @"network": @4 };
         
         // Standard built-in command mappings.
         self.commands = @{
@@ -188,102 +217,138 @@ static void *execQueueKey = "IFCommandScheduler.execQueue";
 }
 
 - (void)executeQueue {
-    if (_execIdx > 0) {
-        // Commands currently being executed from queue, leave these to be completed.
-        return;
-    }
     dispatch_async(execQueue, ^{
+        if (_processing) {
+            // Commands currently being executed from queue, leave these to be completed.
+            return;
+        }
+        _processing = YES;
         [self refreshExecQueue];
         [self executeNextCommand];
     });
 }
 
 - (void)refreshExecQueue {
+    // Exclude commands which are currently being executed.
+    NSMutableSet *runningIDs = [NSMutableSet new];
+    for (IFCommandItem *commandItem in _runningCommands) {
+        if (commandItem.rowid) {
+            [runningIDs addObject:commandItem.rowid];
+        }
+    }
     NSArray *rows = [_db performQuery:@"SELECT * FROM queue WHERE status='P' ORDER BY batch, id ASC" withParams:@[]];
     NSMutableArray *queue = [NSMutableArray new];
     for (NSDictionary *row in rows) {
-        [queue addObject:[[IFCommandItem alloc] initFromRow:row]];
+        if (![runningIDs containsObject:row[@"id"]]) {
+            [queue addObject:[[IFCommandItem alloc] initFromRow:row]];
+        }
     }
     _execQueue = queue;
-    _execIdx = 0;
 }
 
 - (void)executeNextCommand {
     dispatch_async(execQueue, ^{
         if ([_execQueue count] == 0) {
-            // Do nothing if nothing on the queue.
-            _execIdx = -1;
-            return;
-        }
-        if (_execIdx > [_execQueue count] - 1) {
-            // If moved past the end of the queue then try reading a new list of commands from the db.
+            // If at the end of the queue then try reading a new list of commands from the db.
             [self refreshExecQueue];
-            [self executeQueue];
-            return;
         }
-        IFCommandItem *commandItem = [_execQueue objectAtIndex:_execIdx];
-        // Iterate command pointer.
-        _execIdx++;
-        _currentBatch = commandItem.batch;
-        // Find and execute the command.
-        [Logger debug:@"Executing %@ %@", commandItem.name, [commandItem.args componentsJoinedByString:@" "]];
-        id<IFCommand> command = _commands[commandItem.name];
-        if (!command) {
-            [Logger error:@"Command not found: %@", commandItem.name];
-            [self purgeQueue];
+        if ([_execQueue count] == 0 && [_runningCommands count] == 0) {
+            // Nothing left to execute.
+            _processing = NO;
             return;
         }
-        [command execute:commandItem.name withArgs:commandItem.args]
-        .then((id)^(NSArray *commands) {
-            dispatch_async(execQueue, ^{
-                // Queue any new commands, delete current command from db.
-                [_db beginTransaction];
-                for (id item in commands) {
-                    IFCommandItem *command = [self parseCommandItem:item];
-                    if (!command) {
-                        // Indicates an unparseable command line string; just continue to the next command.
-                        continue;
-                    }
-                    // Check for system commands.
-                    if ([@"control.purge-queue" isEqualToString:command.name]) {
-                        [self purgeQueue];
-                        continue;
-                    }
-                    if ([@"control.purge-current-batch" isEqualToString:command.name]) {
-                        [self purgeCurrentBatch];
-                        continue;
-                    }
-                    NSInteger batch = _currentBatch;
-                    if (command.priority) {
-                        batch += [command.priority integerValue];
-                        // Negative priorities can place new commands at the head of the queue; reset the exec queue
-                        // to force a db read, so that these commands are read into the head of the exec queue.
-                        if (batch < _currentBatch) {
-                            _execQueue = @[];
-                        }
-                    }
-                    [Logger debug:@"Appending %@ %@", command.name, command.args];
-                    NSDictionary *values = @{
-                        @"batch":   [NSNumber numberWithInteger:batch],
-                        @"command": command.name,
-                        @"args":    [command.args toJSON],
-                        @"status":  @"P"
-                    };
-                    [_db insertValues:values intoTable:@"queue"];
-                }
-                [self continueQueueProcessingAfterCommand:commandItem];
-                if (commandItem.promise) {
-                    [commandItem.promise resolve:nil];
-                }
-            });
+        // Start all commands which are ready to execute.
+        IFCommandItem *commandItem;
+        while ((commandItem = [self nextReadyCommand])) {
+            [self startCommand:commandItem];
+        }
+    });
+}
+
+- (IFCommandItem *)nextReadyCommand {
+    if ([_execQueue count] == 0) {
+        return nil;
+    }
+    // Only commands in the same batch as any running commands can be started, so that batches
+    // complete in order.
+    IFCommandItem *firstCommand = [_runningCommands count] > 0 ? _runningCommands[0] : _execQueue[0];
+    NSInteger batch = firstCommand.batch;
+    NSMutableDictionary *laneCounts = [NSMutableDictionary new];
+    NSMutableSet *incompleteNames = [NSMutableSet new];
+    for (IFCommandItem *commandItem in _runningCommands) {
+        if (!commandItem.lane) {
+            // A serial command is running; nothing else can start until it completes.
             return nil;
-        })
-        .fail(^(id error) {
-            [Logger error:@"Error executing command %@ %@: %@", commandItem.name, commandItem.args, error];
-            // TODO: Review whether queue should be purged or not. Removed for now - commands
-            // should detect errors caused by previous command failures and deal with accordingly.
-            // [self purgeQueue];
-            [self continueQueueProcessingAfterCommand:commandItem];
+        }
+        NSInteger count = [laneCounts[commandItem.lane] integerValue];
+        laneCounts[commandItem.lane] = [NSNumber numberWithInteger:count + 1];
+        [incompleteNames addObject:commandItem.name];
+    }
+    for (IFCommandItem *commandItem in _execQueue) {
+        if (commandItem.batch != batch) {
+            break;
+        }
+        if (!commandItem.lane) {
+            // Serial commands only start once all preceding commands have completed.
+            if (commandItem == _execQueue[0] && [_runningCommands count] == 0) {
+                return commandItem;
+            }
+            break;
+        }
+        NSInteger count = [laneCounts[commandItem.lane] integerValue];
+        BOOL laneAvailable = count < [self widthOfLane:commandItem.lane];
+        BOOL dependenciesComplete = YES;
+        for (NSString *name in commandItem.depends) {
+            if ([incompleteNames containsObject:name]) {
+                dependenciesComplete = NO;
+                break;
+            }
+        }
+        if (laneAvailable && dependenciesComplete) {
+            return commandItem;
+        }
+        [incompleteNames addObject:commandItem.name];
+    }
+    return nil;
+}
+
+- (NSInteger)widthOfLane:(NSString *)lane {
+    NSNumber *width = _laneWidths[lane];
+    return width ? MAX([width integerValue], 1) : 1;
+}
+
+- (void)startCommand:(IFCommandItem *)commandItem {
+    // Move the command from the exec queue to the list of running commands.
+    [_execQueue removeObjectIdenticalTo:commandItem];
+    [_runningCommands addObject:commandItem];
+    _currentBatch = commandItem.batch;
+    // Find and execute the command.
+    [Logger debug:@"Executing %@ %@", commandItem.name, [commandItem.args componentsJoinedByString:@" "]];
+    id<IFCommand> command = _commands[commandItem.name];
+    if (!command) {
+        [Logger error:@"Command not found: %@", commandItem.name];
+        [_runningCommands removeObjectIdenticalTo:commandItem];
+        [self purgeQueue];
+        [self executeNextCommand];
+        return;
+    }
+    [command execute:commandItem.name withArgs:commandItem.args]
+    .then((id)^(NSArray *commands) {
+        dispatch_async(execQueue, ^{
+            [self completeCommand:commandItem withCommands:commands];
+            if (commandItem.promise) {
+                [commandItem.promise resolve:nil];
+            }
+        });
+        return nil;
+    })
+    .fail(^(id error) {
+        [Logger error:@"Error executing command %@ %@: %@", commandItem.name, commandItem.args, error];
+        // TODO: Review whether queue should be purged or not. Removed for now - commands
+        // should detect errors caused by previous command failures and deal with accordingly.
+        // [self purgeQueue];
+        dispatch_async(execQueue, ^{
+            [self completeCommand:commandItem withCommands:@[]];
             if (commandItem.promise) {
                 [commandItem.promise reject:error];
             }
@@ -291,28 +356,67 @@ static void *execQueueKey = "IFCommandScheduler.execQueue";
     });
 }
 
-- (void)continueQueueProcessingAfterCommand:(IFCommandItem *)commandItem {
-    dispatch_async(execQueue, ^{
-        NSString *rowID = commandItem.rowid;
-        // Check if the command item has a row ID, indicating that it was read from the database.
-        if (rowID != nil) {
-            // Delete the command record from the queue.
-            if (_deleteExecutedQueueRecords) {
-                [_db deleteIDs:@[ rowID ] fromTable:@"queue"];
-            }
-            else {
-                NSDictionary *values = @{
-                    @"id":      rowID,
-                    @"status":  @"X"
-                };
-                [_db updateValues:values inTable:@"queue"];
+- (void)completeCommand:(IFCommandItem *)commandItem withCommands:(NSArray *)commands {
+    // Queue any new commands, delete current command from db.
+    [_db beginTransaction];
+    for (id item in commands) {
+        IFCommandItem *command = [self parseCommandItem:item];
+        if (!command) {
+            // Indicates an unparseable command line string; just continue to the next command.
+            continue;
+        }
+        // Check for system commands.
+        if ([@"control.purge-queue" isEqualToString:command.name]) {
+            [self purgeQueue];
+            continue;
+        }
+        if ([@"control.purge-current-batch" isEqualToString:command.name]) {
+            [self purgeCurrentBatch];
+            continue;
+        }
+        NSInteger batch = commandItem.batch;
+        if (command.priority) {
+            batch += [command.priority integerValue];
+            // Negative priorities can place new commands at the head of the queue; reset the exec queue
+            // to force a db read, so that these commands are read into the head of the exec queue.
+            if (batch < commandItem.batch) {
+                [_execQueue removeAllObjects];
             }
         }
-        // Commit the transaction opened in executeNextCommand:
-        [_db commitTransaction];
-        // Continue to next queued command.
-        [self executeNextCommand];
-    });
+        [Logger debug:@"Appending %@ %@", command.name, command.args];
+        NSMutableDictionary *values = [@{
+            @"batch":   [NSNumber numberWithInteger:batch],
+            @"command": command.name,
+            @"args":    [command.args toJSON],
+            @"status":  @"P"
+        } mutableCopy];
+        if (command.lane) {
+            values[@"lane"] = command.lane;
+        }
+        if ([command.depends count] > 0) {
+            values[@"depends"] = [command.depends toJSON];
+        }
+        [_db insertValues:values intoTable:@"queue"];
+    }
+    NSString *rowID = commandItem.rowid;
+    // Check if the command item has a row ID, indicating that it was read from the database.
+    if (rowID != nil) {
+        // Delete the command record from the queue.
+        if (_deleteExecutedQueueRecords) {
+            [_db deleteIDs:@[ rowID ] fromTable:@"queue"];
+        }
+        else {
+            NSDictionary *values = @{
+                @"id":      rowID,
+                @"status":  @"X"
+            };
+            [_db updateValues:values inTable:@"queue"];
+        }
+    }
+    [_db commitTransaction];
+    [_runningCommands removeObjectIdenticalTo:commandItem];
+    // Continue to next queued command.
+    [self executeNextCommand];
 }
 
 - (IFCommandItem *)parseCommandItem:(id)item {
@@ -329,6 +433,14 @@ static void *execQueueKey = "IFCommandScheduler.execQueue";
                 command.name = name;
                 command.args = args;
                 command.priority = itemDict[@"priority"];
+                command.lane = itemDict[@"lane"];
+                id depends = itemDict[@"depends"];
+                if ([depends isKindOfClass:[NSString class]]) {
+                    depends = @[ depends ];
+                }
+                if ([depends isKindOfClass:[NSArray class]]) {
+                    command.depends = depends;
+                }
                 return command;
             }
         }
@@ -391,13 +503,12 @@ static void *execQueueKey = "IFCommandScheduler.execQueue";
     __block IFCommandItem *commandItem = [[IFCommandItem alloc] initWithCommand:command args:args];
     commandItem.promise = [QPromise new];
     void (^execCommand)() = ^{
-        // Replace the exec queue with a new queue containing just the new command; any other queued commands
-        // will be reloaded from the database afterwards (although note that this means that two or more calls
-        // to this method can't be used reliably, asynchronously, as they may result in one call removing another
-        // queued call; this shouldn't be a problem in practice).
+        // Place the new command at the head of the exec queue. The command is serial, so it won't start until
+        // all running commands - including lane commands from an earlier batch - have completed; the queue
+        // isn't replaced, as running commands may still queue follow up commands.
         // Note that this part of the code is run on the GCD queue, to avoid race conditions on the queue.
-        _execQueue = @[ commandItem ];
-        _execIdx = 0;
+        [_execQueue insertObject:commandItem atIndex:0];
+        _processing = YES;
         [self executeNextCommand];
     };
     if (RunningOnExecQueue) {
@@ -410,11 +521,11 @@ static void *execQueueKey = "IFCommandScheduler.execQueue";
 }
 
 - (void)purgeQueue {
-    // Replace the execution queue with an empty list, delete all queued commands.
-    _execQueue = @[];
-    _execIdx = 0;
-    _currentBatch = 0;
     void (^purge)() = ^() {
+        // Empty the execution queue, delete all queued commands. Note that any running commands are left
+        // to complete; no serial command is started until they have.
+        [_execQueue removeAllObjects];
+        _currentBatch = 0;
         if (_deleteExecutedQueueRecords) {
             [_db deleteFromTable:@"queue" where:@"1 = 1"];
         }
@@ -432,9 +543,8 @@ static void *execQueueKey = "IFCommandScheduler.execQueue";
 }
 
 - (void)purgeCurrentBatch {
-    _execQueue = @[];
-    _execIdx = 0;
     void (^purge)() = ^() {
+        [_execQueue removeAllObjects];
         if (_deleteExecutedQueueRecords) {
             [_db deleteFromTable:@"queue" where:[NSString stringWithFormat:@"batch=%ld", (long)_currentBatch]];
         }
@@ -17,7 +17,7 @@
 //
 
 #import "IFDownloadZipCommand.h"
-#import "IFFileIO.h"
+#import "IFZipExtractor.h"
 
 @implementation IFDownloadZipCommand
 
@@ -48,11 +48,12 @@
         .then((id)^(IFHTTPClientResponse *response) {
             // Schedule commands to unzip the downloaded file before removing it.
             NSString *downloadPath = [response.downloadLocation path];
-            if ([IFFileIO unzipFileAtPath:downloadPath toPath:unzipPath overwrite:NO]) {
+            NSError *error = nil;
+            if ([IFZipExtractor extractArchiveAtPath:downloadPath toPath:unzipPath overwrite:NO error:&error]) {
                 [promise resolve:@[]];
             }
             else {
-                [promise reject:@"Failed to unzip download"];
+                [promise reject:[NSString stringWithFormat:@"Failed to unzip download: %@", error.localizedDescription]];
             }
             [_promises removeObject:promise];
             return nil;
@@ -27,6 +27,9 @@
  * - filename:  The name of the file to write the result to.
  * - attempt:   The number of attempts made to fetch the URL. Defaults to 0 and is incremented after
  *              each failed attempt. The command fails once maxRetries number of attempts has been made.
+ * Request throughput is limited by the HTTP client's rate governor, if it has one, which is shared
+ * by all users of the client; see IFHTTPClient.rateGovernor. The command's own requests can be
+ * further limited using the maxRequestsPerMinute property.
  */
 @interface IFGetURLCommand : NSObject <IFCommand> {
     IFHTTPClient *_httpClient;
@@ -34,12 +37,14 @@
     NSString *_commandName;
     NSString *_url;
     NSString *_filename;
-    NSMutableArray *_requestWindow;
+    /// A rate governor applying the maxRequestsPerMinute limit; nil if there is no limit.
+    IFHTTPRateGovernor *_rateGovernor;
 }
 
 - (id)initWithHTTPClient:(IFHTTPClient *)httpClient;
 
 @property (nonatomic, assign) NSInteger maxRetries;
+/// The maximum number of requests per minute made by the command to each host. Defaults to 0 (no limit).
 @property (nonatomic, assign) float maxRequestsPerMinute;
 
 @end
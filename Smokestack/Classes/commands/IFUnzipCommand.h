@@ -24,6 +24,7 @@
  * Arguments: <zip> <to>
  * - zip:   The path to a zip archive file.
  * - to:    The path to a directory to unzip the archive's contents into.
+ * The archive's entries are extracted in parallel; see IFZipExtractor.
  */
 @interface IFUnzipCommand : NSObject <IFCommand>
 
@@ -17,7 +17,7 @@
 //
 
 #import "IFUnzipCommand.h"
-#import "IFFileIO.h"
+#import "IFZipExtractor.h"
 
 @implementation IFUnzipCommand
 
@@ -31,10 +31,12 @@
     if ([args count] > 2) {
         overwrite = [@"yes" isEqualToString:[args objectAtIndex:2]];
     }
-    if ([IFFileIO unzipFileAtPath:zipPath toPath:toPath overwrite:overwrite]) {
+    // Note that entries are extracted in parallel.
+    NSError *error = nil;
+    if ([IFZipExtractor extractArchiveAtPath:zipPath toPath:toPath overwrite:overwrite error:&error]) {
         return [Q resolve:@[]];
     }
-    return [Q reject:@"Failed to unzip file"];
+    return [Q reject:[NSString stringWithFormat:@"Failed to unzip file: %@", error.localizedDescription]];
 }
 
 @end
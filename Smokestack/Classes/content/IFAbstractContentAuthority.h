@@ -46,6 +46,12 @@
 @interface IFAbstractContentAuthority : IFContainer <IFContentAuthority, IFIOCTypeInspectable> {
     /// A set of live NSURL responses.
     NSMutableSet *_liveResponses;
+    /// A timer for the next scheduled content refresh.
+    NSTimer *_refreshTimer;
+    /// The current delay between content refreshes, in seconds; increased while refreshes find no changes.
+    NSTimeInterval _refreshDelay;
+    /// The time the in-flight content refresh was started; nil if no refresh is in flight.
+    NSDate *_refreshStartTime;
 }
 
 /// The name of the authority that the class instance is bound to.
@@ -62,11 +68,31 @@
 @property (nonatomic, readonly) NSString *packagedContentPath;
 /// Interval between content refreshes; in minutes.
 @property (nonatomic, assign) CGFloat refreshInterval;
+/**
+ * The maximum interval between content refreshes; in minutes.
+ * When greater than refreshInterval, the interval between scheduled refreshes is doubled after each
+ * refresh which finds no changes, up to this maximum, and is reset to refreshInterval once a refresh
+ * finds changes. Only applies to subclasses which report refresh completion.
+ */
+@property (nonatomic, assign) CGFloat maxRefreshInterval;
 
 /**
  * Refreshed content, e.g. by checking a server for downloadable updates.
  * Subclasses should provide an implementation of this class.
  */
 - (void)refreshContent;
+/**
+ * Notify the authority that a content refresh has started.
+ * Scheduled refreshes are skipped while a refresh is in flight. Subclasses which call this method
+ * must call refreshDidCompleteWithChanges:nextCheck: when the refresh completes or fails.
+ */
+- (void)refreshDidStart;
+/**
+ * Notify the authority that a content refresh has completed.
+ * The next scheduled refresh is rescheduled according to whether the refresh found changes. If
+ * nextCheck is greater than zero (e.g. a server provided retry-after hint) then the next refresh
+ * is scheduled after that many seconds instead. Can be called from any thread.
+ */
+- (void)refreshDidCompleteWithChanges:(BOOL)changed nextCheck:(NSTimeInterval)nextCheck;
 
 @end
@@ -22,6 +22,9 @@
 #import "NSArray+IF.h"
 #import "IFCompoundURI.h"
 
+/// The time after which an in-flight refresh is assumed to have been lost (e.g. purged from the command queue), in seconds.
+#define RefreshInFlightTimeout  (600.0)
+
 @implementation IFCMSAbstractContentAuthorityConfigurationProxy
 
 #pragma mark - IFIOCObjectAware
@@ -50,6 +53,15 @@
 
 @end
 
+@interface IFAbstractContentAuthority ()
+
+/// Schedule the next content refresh after the specified delay, replacing any currently scheduled refresh.
+- (void)scheduleRefreshAfter:(NSTimeInterval)delay;
+/// Handle a refresh timer tick.
+- (void)refreshTimerFired:(NSTimer *)timer;
+
+@end
+
 @implementation IFAbstractContentAuthority
 
 @synthesize provider;
@@ -81,17 +93,59 @@
 
 - (void)refreshContent {}
 
+- (void)refreshDidStart {
+    dispatch_async(dispatch_get_main_queue(), ^{
+        _refreshStartTime = [NSDate date];
+    });
+}
+
+- (void)refreshDidCompleteWithChanges:(BOOL)changed nextCheck:(NSTimeInterval)nextCheck {
+    dispatch_async(dispatch_get_main_queue(), ^{
+        _refreshStartTime = nil;
+        if (_refreshInterval <= 0) {
+            return;
+        }
+        NSTimeInterval interval = _refreshInterval * 60.0;
+        if (changed || _refreshDelay < interval) {
+            _refreshDelay = interval;
+        }
+        else if (_maxRefreshInterval > _refreshInterval) {
+            // Back off exponentially while refreshes find no changes.
+            _refreshDelay = MIN(_refreshDelay * 2.0, _maxRefreshInterval * 60.0);
+        }
+        [self scheduleRefreshAfter:(nextCheck > 0 ? nextCheck : _refreshDelay)];
+    });
+}
+
+- (void)scheduleRefreshAfter:(NSTimeInterval)delay {
+    [_refreshTimer invalidate];
+    _refreshTimer = [NSTimer scheduledTimerWithTimeInterval:delay
+                                                     target:self
+                                                   selector:@selector(refreshTimerFired:)
+                                                   userInfo:nil
+                                                    repeats:NO];
+}
+
+- (void)refreshTimerFired:(NSTimer *)timer {
+    // Schedule the next tick now, in case the refresh doesn't report completion; if it does then the
+    // tick is rescheduled according to the refresh result.
+    [self scheduleRefreshAfter:_refreshDelay];
+    // Skip the tick if a refresh is still in flight.
+    if (_refreshStartTime && -[_refreshStartTime timeIntervalSinceNow] < RefreshInFlightTimeout) {
+        return;
+    }
+    [self refreshContent];
+}
+
 #pragma mark - IFService
 
 - (void)startService {
     [super startService];
-    // Schedule content refreshes.
+    // Schedule content refreshes. Note that a timer is scheduled for each refresh, as the interval
+    // between refreshes varies.
     if (_refreshInterval > 0) {
-        [NSTimer scheduledTimerWithTimeInterval:(_refreshInterval * 60.0f)
-                                         target:self
-                                       selector:@selector(refreshContent)
-                                       userInfo:nil
-                                        repeats:YES];
+        _refreshDelay = _refreshInterval * 60.0;
+        [self scheduleRefreshAfter:_refreshDelay];
     }
 }
 
@@ -38,7 +38,11 @@
 @property (nonatomic, strong) NSNumber *version;
 /** Flag indicating whether to reset the database at startup. */
 @property (nonatomic, assign) BOOL resetDatabase;
-/** Database table schemas + initial data. */
+/**
+ * Database table schemas + initial data.
+ * A column schema with a 'unique' value of YES has a unique index; the index is created with the
+ * table, or when the database is next migrated if the table already exists.
+ */
 @property (nonatomic, strong) NSDictionary *tables;
 /** Object/relational mappings defined for the database. */
 @property (nonatomic, strong) IFDBORM *orm;
@@ -46,6 +46,7 @@ static IFLogger *Logger;
 
 - (NSString *)getCreateTableSQLForTable:(NSString *)tableName schema:(NSDictionary *)tableSchema;
 - (NSArray *)getAlterTableSQLForTable:(NSString *)tableName schema:(NSDictionary *)tableSchema from:(NSInteger)oldVersion to:(NSInteger)newVersion;
+- (NSArray *)getCreateIndexSQLForTable:(NSString *)tableName schema:(NSDictionary *)tableSchema;
 - (void)dbInitialize:(IFSqliteDB *)db error:(NSError **)error;
 - (void)addInitialDataForTable:(NSString *)tableName schema:(NSDictionary *)tableSchema;
 
@@ -497,6 +498,12 @@ static IFLogger *Logger;
         if (*error) {
             return;
         }
+        for (NSString *indexSQL in [self getCreateIndexSQLForTable:tableName schema:tableSchema]) {
+            [db executeUpdate:indexSQL parameters:nil error:error];
+            if (*error) {
+                return;
+            }
+        }
         [self addInitialDataForTable:tableName schema:tableSchema];
     }
     [self dbInitialize:db error:error];
@@ -520,6 +527,7 @@ static IFLogger *Logger;
             else {
                 // Modify table.
                 sqls = [self getAlterTableSQLForTable:tableName schema:tableSchema from:oldVersion to:newVersion];
+                sqls = [sqls arrayByAddingObjectsFromArray:[self getCreateIndexSQLForTable:tableName schema:tableSchema]];
             }
         }
         else {
@@ -532,6 +540,7 @@ static IFLogger *Logger;
             else {
                 // Create table.
                 sqls = [NSArray arrayWithObject:[self getCreateTableSQLForTable:tableName schema:tableSchema]];
+                sqls = [sqls arrayByAddingObjectsFromArray:[self getCreateIndexSQLForTable:tableName schema:tableSchema]];
                 [self addInitialDataForTable:tableName schema:tableSchema];
             }
         }
@@ -611,4 +620,24 @@ static IFLogger *Logger;
     return sqls;
 }
 
+- (NSArray *)getCreateIndexSQLForTable:(NSString *)tableName schema:(NSDictionary *)tableSchema {
+    NSMutableArray *sqls = [[NSMutableArray alloc] init];
+    NSDictionary *columns = [tableSchema valueForKey:@"columns"];
+    for (NSString *colName in [columns allKeys]) {
+        NSDictionary *colSchema = [columns objectForKey:colName];
+        if (![[colSchema getValueAsNumber:@"unique" defaultValue:@NO] boolValue]) {
+            continue;
+        }
+        // An existing table may already contain duplicate values, which would prevent the index from
+        // being created; keep only the most recently inserted row for each value.
+        NSString *sql = [NSString stringWithFormat:@"DELETE FROM %@ WHERE rowid NOT IN (SELECT max(rowid) FROM %@ GROUP BY %@)",
+                         tableName, tableName, colName];
+        [sqls addObject:sql];
+        sql = [NSString stringWithFormat:@"CREATE UNIQUE INDEX IF NOT EXISTS %@_%@ ON %@ (%@)",
+               tableName, colName, tableName, colName];
+        [sqls addObject:sql];
+    }
+    return sqls;
+}
+
 @end
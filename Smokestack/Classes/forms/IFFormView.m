@@ -199,21 +199,32 @@
     return statusCode >= 400;
 }
 
+// Note that the following methods are called on the HTTP client's callback queue; response data is
+// parsed there, and the submit callbacks are then dispatched to the main queue.
+
 - (void)submitRequestError:(NSError *)error {
     if (_onSubmitRequestError) {
-        _onSubmitRequestError(self, error);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            _onSubmitRequestError(self, error);
+        });
     }
 }
 
 - (void)submitError:(IFHTTPClientResponse *)response {
     if (_onSubmitError) {
-        _onSubmitError(self, [response parseData]);
+        id data = [response parseData];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            _onSubmitError(self, data);
+        });
     }
 }
 
 - (void)submitOk:(IFHTTPClientResponse *)response {
     if (_onSubmitOk) {
-        _onSubmitOk(self, [response parseData]);
+        id data = [response parseData];
+        dispatch_async(dispatch_get_main_queue(), ^{
+            _onSubmitOk(self, data);
+        });
     }
 }
 
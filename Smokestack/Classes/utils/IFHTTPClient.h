@@ -18,14 +18,62 @@
 
 #import <Foundation/Foundation.h>
 #import <Q/Q.h>
+#import "IFHTTPValidatorStore.h"
+#import "IFHTTPRateGovernor.h"
+#import "IFHTTPMetrics.h"
 
 /// HTTP client request option; set the Accept header value.
 extern NSString const * _Nonnull IFHTTPClientRequestOptionAccept;
 /// HTTP client request option; set the Accept-Encoding header value.
 extern NSString const * _Nonnull IFHTTPClientRequestOptionAcceptEncoding;
+/**
+ * HTTP client request option; the path at which the caller stores a file download's content.
+ * Used with the client's validator store to make conditional file requests; see getFile:.
+ */
+extern NSString const * _Nonnull IFHTTPClientRequestOptionCachedLocation;
+/**
+ * HTTP client request option; a path at which to keep a file download's partial data.
+ * Makes a file download resumable; see getFile:.
+ */
+extern NSString const * _Nonnull IFHTTPClientRequestOptionResumePath;
 
 @class IFHTTPClient;
 
+/// A receiver for response data streamed from an HTTP request.
+@protocol IFHTTPClientDataReceiver <NSObject>
+
+/// Called once the response headers have been received.
+- (void)receiveResponse:(NSHTTPURLResponse * _Nonnull)response;
+/// Called as each chunk of response body data arrives.
+- (void)receiveData:(NSData * _Nonnull)data;
+
+@end
+
+/// A provider of Authorization header values, attached to requests before they are sent.
+@protocol IFHTTPClientAuthorizationProvider <NSObject>
+
+/// Return the Authorization header value for a request URL, or nil if no header should be sent.
+- (NSString * _Nullable)authorizationHeaderForURL:(NSURL * _Nonnull)url;
+
+@end
+
+/**
+ * A streaming decoder for an HTTP response content encoding.
+ * Encoded response data is passed to the decoder in chunks, as it arrives, and the decoder returns
+ * the decoded data available so far; each decoder instance is used for a single response.
+ */
+@protocol IFHTTPContentDecoder <NSObject>
+
+/// Decode a chunk of encoded data. Returns the decoded data, or nil if the data can't be decoded.
+- (NSData * _Nullable)decodeData:(NSData * _Nonnull)data error:(NSError * _Nullable * _Nullable)error;
+/// Finish decoding. Returns any remaining decoded data, or nil if the encoded data is incomplete.
+- (NSData * _Nullable)finish:(NSError * _Nullable * _Nullable)error;
+
+@end
+
+/// A factory for content decoders; returns a new decoder instance for each response.
+typedef id<IFHTTPContentDecoder> _Nonnull (^IFHTTPContentDecoderFactory) (void);
+
 /// An HTTP response.
 @interface IFHTTPClientResponse : NSObject
 
@@ -35,6 +83,8 @@ extern NSString const * _Nonnull IFHTTPClientRequestOptionAcceptEncoding;
 @property (nonatomic, strong) NSHTTPURLResponse * _Nonnull httpResponse;
 @property (nonatomic, strong) NSData * _Nullable data;
 @property (nonatomic, strong) NSURL * _Nullable downloadLocation;
+/// Network timing metrics for the request, if available.
+@property (nonatomic, strong) IFHTTPRequestMetrics * _Nullable metrics;
 
 /**
  * Parse the response data.
@@ -44,11 +94,82 @@ extern NSString const * _Nonnull IFHTTPClientRequestOptionAcceptEncoding;
 
 @end
 
-@interface IFHTTPClient : NSObject
+/**
+ * An HTTP client.
+ * Promises returned by the client are resolved on a serial background queue, so that response
+ * handling (e.g. parsing response data) doesn't block the main thread; any UI updates made in
+ * response handlers should be dispatched to the main queue.
+ */
+@interface IFHTTPClient : NSObject {
+    /// A serial queue for session delegate callbacks and request completion handlers.
+    NSOperationQueue *_callbackQueue;
+    /// A serial queue for delivering streamed response data.
+    NSOperationQueue *_streamQueue;
+    /// The URL session used for all of the client's requests.
+    NSURLSession *_session;
+    /// Promises for GET requests currently in flight, keyed by request method, URL and options.
+    NSMutableDictionary *_inflightRequests;
+    /// Registered content decoder factories, keyed by content encoding name.
+    NSMutableDictionary *_contentDecoders;
+}
 
 - (id _Nonnull)initWithNSURLSessionTaskDelegate:(id<NSURLSessionTaskDelegate> _Nullable)sessionTaskDelegate;
 
+/**
+ * Return an Accept-Encoding header value listing the content encodings decoded by the URL loading
+ * system on the current OS version; i.e. "br, gzip" from iOS 11, otherwise "gzip".
+ */
++ (NSString * _Nonnull)nativeAcceptEncodings;
+
 @property (nonatomic, weak) id<NSURLSessionTaskDelegate> _Nullable sessionTaskDelegate;
+/**
+ * An optional provider of preemptive Authorization headers.
+ * When set, each request is sent with the Authorization header returned by the provider, avoiding
+ * the extra round trip of an authentication challenge.
+ */
+@property (nonatomic, weak) id<IFHTTPClientAuthorizationProvider> _Nullable authorizationProvider;
+/**
+ * An optional governor of request throughput.
+ * When set, all of the client's requests are submitted through the governor, which applies per-host
+ * rate and concurrency limits; requests are only started once the governor allows.
+ */
+@property (nonatomic, strong) IFHTTPRateGovernor * _Nullable rateGovernor;
+/// An optional store of cache validators, used to make conditional file requests.
+@property (nonatomic, strong) IFHTTPValidatorStore * _Nullable validatorStore;
+/**
+ * The maximum number of simultaneous connections to make to a single host.
+ * The client uses a single, long-lived URL session for all its requests, so that connections
+ * can be kept alive and reused between requests. Must be set before the client's first request
+ * to have any effect. Defaults to 4.
+ */
+@property (nonatomic, assign) NSInteger maxConnectionsPerHost;
+/**
+ * The number of GET requests coalesced with an identical request already in flight.
+ * A GET or file GET made while an identical request (same URL, query data and options) is still
+ * in flight doesn't start a new transfer; instead, the caller receives the in-flight request's
+ * promise. Streamed GETs and POSTs are never coalesced. Also reported in the metrics snapshot.
+ */
+@property (atomic, assign, readonly) NSUInteger coalescedRequestCount;
+/**
+ * The client's request metrics.
+ * Network timing metrics (DNS, connect, TLS, time to first byte, transfer, bytes) are collected for
+ * every request; the metrics for each request are also attached to its response. Use the recorder's
+ * snapshot methods to get per-endpoint histograms of recent requests.
+ */
+@property (nonatomic, strong, readonly) IFHTTPMetricsRecorder * _Nonnull metrics;
+
+/**
+ * Register a decoder for a response content encoding, e.g. zstd.
+ * Responses whose Content-Encoding matches the encoding are decoded using a new decoder from the
+ * factory. Data responses are decoded before the request promise resolves; streamed responses
+ * are decoded chunk by chunk before being passed to the data receiver; and file downloads are
+ * decoded to a new file once the download completes. The encoding should also be listed in the
+ * request's Accept-Encoding option.
+ * Note that the URL loading system already decodes gzip and deflate responses, and br (Brotli)
+ * responses from iOS 11, so decoders are never used for those encodings. A br decoder can be
+ * registered to accept Brotli content on earlier OS versions.
+ */
+- (void)registerContentDecoder:(IFHTTPContentDecoderFactory _Nonnull)factory forEncoding:(NSString * _Nonnull)encoding;
 
 /**
  * Get a URL.
@@ -67,6 +188,19 @@ extern NSString const * _Nonnull IFHTTPClientRequestOptionAcceptEncoding;
  * @param options   Additional request options, see the IFHTTPClientRequestOptionXXX constants.
  */
 - (QPromise * _Nonnull)get:(NSString * _Nonnull)url data:(NSDictionary * _Nullable)data options:( NSDictionary * _Nullable )options;
+/**
+ * Get a URL, streaming the response body to a data receiver as it arrives.
+ * The response body isn't buffered, so the promise resolves to a response without data once
+ * the request has completed. Data receiver methods are called on a background queue.
+ * As with getFile:, if the client has a validator store and the IFHTTPClientRequestOptionCachedLocation
+ * option is specified then the request is conditional on the validators of a previous 200 response;
+ * the receiver is responsible for storing the content at the cached location.
+ * @param url       The URL to get.
+ * @param data      Data to include in the URL's query string.
+ * @param options   Additional request options, see the IFHTTPClientRequestOptionXXX constants.
+ * @param receiver  A receiver for the response data.
+ */
+- (QPromise * _Nonnull)get:(NSString * _Nonnull)url data:(NSDictionary * _Nullable)data options:( NSDictionary * _Nullable )options receiver:(id<IFHTTPClientDataReceiver> _Nonnull)receiver;
 /**
  * Get a file from a URL.
  */
@@ -79,6 +213,25 @@ extern NSString const * _Nonnull IFHTTPClientRequestOptionAcceptEncoding;
 - (QPromise * _Nonnull)getFile:(NSString * _Nonnull)url data:(NSDictionary * _Nullable)data;
 /**
  * Get a file from a URL, passing the specified data.
+ * Note that concurrent identical requests share a single download, and so resolve with the same
+ * download location; callers should allow for the downloaded file having been moved by another
+ * caller.
+ * If the client has a validator store and the IFHTTPClientRequestOptionCachedLocation option is
+ * specified, then the request is made conditional on any validators recorded from a previous
+ * download of the same URL; and if the server responds with 304 Not Modified, then the promise
+ * resolves with a response whose download location is the cached location. The caller is expected
+ * to store the content of a 200 response at the cached location.
+ * If the IFHTTPClientRequestOptionResumePath option is specified, then the download is resumable;
+ * response data is written to a partial download file at the resume path as it arrives, and is kept
+ * there if the download is interrupted. A later request for the same URL then requests only the
+ * remaining data, using a Range request which is conditional (If-Range) on the resource's
+ * validators being unchanged. The remaining data is requested without content encoding (i.e. the
+ * Accept-Encoding option only applies to the initial request); and a download whose content is in
+ * an encoding not decoded by the URL loading system (e.g. zstd) can't be resumed. If the server supplies a checksum of the resource (a Repr-Digest,
+ * Digest or Content-MD5 header) then the completed download is checked against it, and discarded
+ * if it doesn't match. The partial download file is deleted once the download completes, or if the
+ * server responds 304, 412 or 416; it is kept after other responses (e.g. a 503), so that a later
+ * request can resume it.
  * @param url       The URL to get.
  * @param data      Data to include in the URL's query string.
  * @param options   Additional request options, see the IFHTTPClientRequestOptionXXX constants.
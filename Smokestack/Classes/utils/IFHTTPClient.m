@@ -18,22 +18,149 @@
 
 #import "IFHTTPClient.h"
 #import "SSKeychain.h"
+#import <CommonCrypto/CommonDigest.h>
 #import <MPMessagePack/MPMessagePack.h>
 
 #define LogJSONResponse (0)
 
 NSString const * _Nonnull IFHTTPClientRequestOptionAccept           = @"IFHTTPClientRequestOptionAccept";
 NSString const * _Nonnull IFHTTPClientRequestOptionAcceptEncoding   = @"IFHTTPClientRequestOptionAcceptEncoding";
+NSString const * _Nonnull IFHTTPClientRequestOptionCachedLocation   = @"IFHTTPClientRequestOptionCachedLocation";
+NSString const * _Nonnull IFHTTPClientRequestOptionResumePath       = @"IFHTTPClientRequestOptionResumePath";
 
 typedef QPromise *(^IFHTTPClientAction)();
 
+#define DecodeBufferSize    (64 * 1024)
+
+/// Content encodings decoded by the URL loading system.
+static NSSet *NativeContentEncodings;
+
+/// A task delegate for streamed requests; delivers response data to a receiver on the stream queue.
+@interface IFHTTPClientStreamTaskDelegate : NSObject <NSURLSessionDataDelegate> {
+    id<IFHTTPClientDataReceiver> _receiver;
+    NSOperationQueue *_queue;
+    QPromise *_promise;
+    /// A decoder for the response content, if the response content encoding requires decoding.
+    id<IFHTTPContentDecoder> _decoder;
+    /// Any error which occurred when decoding the response content.
+    NSError *_decodeError;
+}
+
+- (id)initWithReceiver:(id<IFHTTPClientDataReceiver>)receiver
+                 queue:(NSOperationQueue *)queue
+               promise:(QPromise *)promise;
+
+/// The client whose content decoders are used to decode the response; nil if the response shouldn't be decoded.
+@property (nonatomic, weak) IFHTTPClient *decodingClient;
+
+/// The task's metrics; attached to the response when the task completes.
+@property (nonatomic, strong) IFHTTPRequestMetrics *metrics;
+
+@end
+
+/**
+ * The client's URL session delegate.
+ * Forwards authentication challenges to the client's task delegate, and streamed data task
+ * events to the task's stream delegate.
+ */
+@interface IFHTTPClientSessionDelegate : NSObject <NSURLSessionDataDelegate> {
+    __weak IFHTTPClient *_client;
+    /// Stream task delegates, keyed by task identifier.
+    NSMutableDictionary *_streamTaskDelegates;
+    /// Metrics for tasks not yet completed, keyed by task identifier.
+    NSMutableDictionary *_taskMetrics;
+}
+
+- (id)initWithClient:(IFHTTPClient *)client;
+/// Register a stream delegate for a data task.
+- (void)setStreamTaskDelegate:(IFHTTPClientStreamTaskDelegate *)delegate forTask:(NSURLSessionTask *)task;
+/// Return and forget the metrics collected for a task.
+- (IFHTTPRequestMetrics *)takeMetricsForTask:(NSURLSessionTask *)task;
+
+@end
+
+/// A data receiver for resumable file downloads; writes response data to a partial download file.
+@interface IFHTTPClientFileReceiver : NSObject <IFHTTPClientDataReceiver> {
+    /// The path of the partial download file.
+    NSString *_path;
+    /// The path of a file recording the partial download's URL and validators.
+    NSString *_infoPath;
+    /// The download URL.
+    NSURL *_url;
+    /// The number of bytes previously downloaded, when resuming a download.
+    unsigned long long _offset;
+    /// A handle for writing to the partial download file.
+    NSFileHandle *_fileHandle;
+    /// The strong ETag of the resource when the partial download was started, if any.
+    NSString *_etag;
+    /// A checksum of the full resource supplied by the server, as a digest header value; may be nil.
+    NSString *_digest;
+    /// Flag indicating whether the response content is encoded, in which case it can't be checked against the checksum.
+    BOOL _encoded;
+}
+
+- (id)initWithPath:(NSString *)path url:(NSURL *)url;
+
+/// Any error which occurred when receiving the response.
+@property (nonatomic, strong, readonly) NSError *error;
+
+/// Add range headers to a request, if a previous partial download of the same URL can be resumed.
+- (void)prepareRequest:(NSMutableURLRequest *)request;
+/**
+ * Check a completed download against any checksum of the resource supplied by the server.
+ * Accepts Repr-Digest, Digest and (for full responses) Content-MD5 headers, using SHA-256 or MD5.
+ * Returns YES if the download matches, or if no usable checksum was supplied.
+ */
+- (BOOL)verify:(NSError **)error;
+/// Close the partial download file.
+- (void)close;
+/// Close and delete the partial download file.
+- (void)discard;
+
+@end
+
 @interface IFHTTPClient()
 
 - (void)setOptions:(NSDictionary *)options onRequest:(NSMutableURLRequest *)request;
-- (QPromise *)submitAction:(IFHTTPClientAction)action;
-- (NSURLSession *)makeSession;
+/**
+ * Start a streamed request; the promise resolves once the request completes.
+ * If decodeContent is YES then response data is decoded before being passed to the receiver.
+ */
+- (void)startStreamedRequest:(NSURLRequest *)request
+                    receiver:(id<IFHTTPClientDataReceiver>)receiver
+               decodeContent:(BOOL)decodeContent
+                     promise:(QPromise *)promise;
+/// Get a file using a resumable download.
+- (void)getFileWithRequest:(NSMutableURLRequest *)request
+                resumePath:(NSString *)resumePath
+            cachedLocation:(NSString *)cachedLocation
+                   promise:(QPromise *)promise;
+/// Submit a request action; the action is passed through the rate governor, if any.
+- (QPromise *)submitAction:(IFHTTPClientAction)action forURL:(NSURL *)url;
+/**
+ * Submit a coalesced request action.
+ * If a request with the same key is already in flight then its promise is returned, and the action
+ * isn't submitted; otherwise the action is submitted and its promise recorded until it completes.
+ */
+- (QPromise *)submitAction:(IFHTTPClientAction)action forURL:(NSURL *)url coalescingWithKey:(NSString *)key;
+/// Return the client's URL session; the session is created on first use.
+- (NSURLSession *)session;
+/// Return the metrics collected for a completed task.
+- (IFHTTPRequestMetrics *)takeMetricsForTask:(NSURLSessionTask *)task;
+/// Return a new content decoder for a response, or nil if the response doesn't need decoding.
+- (id<IFHTTPContentDecoder>)contentDecoderForResponse:(NSURLResponse *)response;
+/// Decode response data. Returns the data unchanged if it doesn't need decoding, or nil if it can't be decoded.
+- (NSData *)decodeData:(NSData *)data forResponse:(NSURLResponse *)response error:(NSError **)error;
+/**
+ * Decode a downloaded response file.
+ * Returns the location of a new temporary file containing the decoded content; or the original
+ * location if the file doesn't need decoding; or nil if the file can't be decoded.
+ */
+- (NSURL *)decodeFileAtURL:(NSURL *)location forResponse:(NSURLResponse *)response error:(NSError **)error;
 
 NSURL *makeURL(NSString *url, NSDictionary *params);
+NSString *makeRequestKey(NSString *method, NSURL *url, NSDictionary *options);
+NSError *makeDecodingError(NSError *error);
 
 @end
 
@@ -98,16 +225,429 @@ NSURL *makeURL(NSString *url, NSDictionary *params);
 
 @end
 
+@implementation IFHTTPClientStreamTaskDelegate
+
+- (id)initWithReceiver:(id<IFHTTPClientDataReceiver>)receiver
+                 queue:(NSOperationQueue *)queue
+               promise:(QPromise *)promise {
+    self = [super init];
+    if (self) {
+        _receiver = receiver;
+        _queue = queue;
+        _promise = promise;
+    }
+    return self;
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    _decoder = [_decodingClient contentDecoderForResponse:response];
+    id<IFHTTPClientDataReceiver> receiver = _receiver;
+    [_queue addOperationWithBlock:^{
+        [receiver receiveResponse:(NSHTTPURLResponse *)response];
+    }];
+    completionHandler(NSURLSessionResponseAllow);
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    id<IFHTTPClientDataReceiver> receiver = _receiver;
+    id<IFHTTPContentDecoder> decoder = _decoder;
+    [_queue addOperationWithBlock:^{
+        if (!decoder) {
+            [receiver receiveData:data];
+            return;
+        }
+        // Decode on the stream queue; once a decoding error occurs, the remaining data is ignored.
+        if (_decodeError) {
+            return;
+        }
+        NSError *error = nil;
+        NSData *decoded = [decoder decodeData:data error:&error];
+        if (!decoded) {
+            _decodeError = makeDecodingError(error);
+        }
+        else if ([decoded length] > 0) {
+            [receiver receiveData:decoded];
+        }
+    }];
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    // Resolve on the stream queue, after all data has been delivered to the receiver.
+    QPromise *promise = _promise;
+    id<IFHTTPClientDataReceiver> receiver = _receiver;
+    id<IFHTTPContentDecoder> decoder = _decoder;
+    [_queue addOperationWithBlock:^{
+        if (!error && decoder && !_decodeError) {
+            // Deliver any remaining decoded data.
+            NSError *finishError = nil;
+            NSData *decoded = [decoder finish:&finishError];
+            if (!decoded) {
+                _decodeError = makeDecodingError(finishError);
+            }
+            else if ([decoded length] > 0) {
+                [receiver receiveData:decoded];
+            }
+        }
+        if (error) {
+            [promise reject:error];
+        }
+        else if (_decodeError) {
+            [promise reject:_decodeError];
+        }
+        else {
+            IFHTTPClientResponse *response = [[IFHTTPClientResponse alloc] initWithHTTPResponse:task.response data:nil];
+            response.metrics = _metrics;
+            [promise resolve:response];
+        }
+    }];
+}
+
+@end
+
+@implementation IFHTTPClientSessionDelegate
+
+- (id)initWithClient:(IFHTTPClient *)client {
+    self = [super init];
+    if (self) {
+        _client = client;
+        _streamTaskDelegates = [NSMutableDictionary new];
+        _taskMetrics = [NSMutableDictionary new];
+    }
+    return self;
+}
+
+- (void)setStreamTaskDelegate:(IFHTTPClientStreamTaskDelegate *)delegate forTask:(NSURLSessionTask *)task {
+    @synchronized (_streamTaskDelegates) {
+        _streamTaskDelegates[[NSNumber numberWithUnsignedInteger:task.taskIdentifier]] = delegate;
+    }
+}
+
+- (IFHTTPClientStreamTaskDelegate *)streamTaskDelegateForTask:(NSURLSessionTask *)task {
+    @synchronized (_streamTaskDelegates) {
+        return _streamTaskDelegates[[NSNumber numberWithUnsignedInteger:task.taskIdentifier]];
+    }
+}
+
+- (IFHTTPRequestMetrics *)takeMetricsForTask:(NSURLSessionTask *)task {
+    NSNumber *taskID = [NSNumber numberWithUnsignedInteger:task.taskIdentifier];
+    @synchronized (_taskMetrics) {
+        IFHTTPRequestMetrics *metrics = _taskMetrics[taskID];
+        [_taskMetrics removeObjectForKey:taskID];
+        return metrics;
+    }
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+- (void)URLSession:(NSURLSession *)session
+          dataTask:(NSURLSessionDataTask *)dataTask
+didReceiveResponse:(NSURLResponse *)response
+ completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+    IFHTTPClientStreamTaskDelegate *delegate = [self streamTaskDelegateForTask:dataTask];
+    if (delegate) {
+        [delegate URLSession:session dataTask:dataTask didReceiveResponse:response completionHandler:completionHandler];
+    }
+    else {
+        completionHandler(NSURLSessionResponseAllow);
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+    [[self streamTaskDelegateForTask:dataTask] URLSession:session dataTask:dataTask didReceiveData:data];
+}
+
+- (void)URLSession:(NSURLSession *)session
+              task:(NSURLSessionTask *)task
+didReceiveChallenge:(NSURLAuthenticationChallenge *)challenge
+ completionHandler:(void (^)(NSURLSessionAuthChallengeDisposition, NSURLCredential * _Nullable))completionHandler {
+    // Forward authentication challenges to the client's task delegate.
+    id<NSURLSessionTaskDelegate> sessionTaskDelegate = _client.sessionTaskDelegate;
+    if ([sessionTaskDelegate respondsToSelector:@selector(URLSession:task:didReceiveChallenge:completionHandler:)]) {
+        [sessionTaskDelegate URLSession:session task:task didReceiveChallenge:challenge completionHandler:completionHandler];
+    }
+    else {
+        completionHandler(NSURLSessionAuthChallengePerformDefaultHandling, nil);
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didFinishCollectingMetrics:(NSURLSessionTaskMetrics *)metrics {
+    // Note that metrics are delivered before the task's completion handler is called.
+    IFHTTPRequestMetrics *requestMetrics = [[IFHTTPRequestMetrics alloc] initWithTask:task metrics:metrics];
+    [_client.metrics recordMetrics:requestMetrics];
+    @synchronized (_taskMetrics) {
+        _taskMetrics[[NSNumber numberWithUnsignedInteger:task.taskIdentifier]] = requestMetrics;
+    }
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error {
+    IFHTTPClientStreamTaskDelegate *delegate = [self streamTaskDelegateForTask:task];
+    if (delegate) {
+        delegate.metrics = [self takeMetricsForTask:task];
+        [delegate URLSession:session task:task didCompleteWithError:error];
+        @synchronized (_streamTaskDelegates) {
+            [_streamTaskDelegates removeObjectForKey:[NSNumber numberWithUnsignedInteger:task.taskIdentifier]];
+        }
+    }
+}
+
+@end
+
+@implementation IFHTTPClientFileReceiver
+
+- (id)initWithPath:(NSString *)path url:(NSURL *)url {
+    self = [super init];
+    if (self) {
+        _path = path;
+        _infoPath = [path stringByAppendingPathExtension:@"info"];
+        _url = url;
+    }
+    return self;
+}
+
+- (void)prepareRequest:(NSMutableURLRequest *)request {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDictionary *info = [NSDictionary dictionaryWithContentsOfFile:_infoPath];
+    if (!(info && [_url.absoluteString isEqualToString:info[@"url"]] && [fileManager fileExistsAtPath:_path])) {
+        return;
+    }
+    _digest = info[@"digest"];
+    // Note that weak ETags can't be used with If-Range.
+    NSString *validator = info[@"etag"];
+    if (validator && ![validator hasPrefix:@"W/"]) {
+        _etag = validator;
+    }
+    if (!validator || [validator hasPrefix:@"W/"]) {
+        validator = info[@"lastModified"];
+    }
+    if (!validator) {
+        return;
+    }
+    _offset = [[fileManager attributesOfItemAtPath:_path error:nil] fileSize];
+    if (_offset > 0) {
+        [request setValue:[NSString stringWithFormat:@"bytes=%llu-", _offset] forHTTPHeaderField:@"Range"];
+        // The server will send the full resource instead if it no longer matches the validator.
+        [request setValue:validator forHTTPHeaderField:@"If-Range"];
+        // The partial download holds unencoded content (natively decoded content is the same as the
+        // unencoded representation; see receiveResponse:), so request the remainder unencoded, so
+        // that the range offset refers to the downloaded bytes.
+        [request setValue:@"identity" forHTTPHeaderField:@"Accept-Encoding"];
+        // Conditional GET headers don't apply to a resumed download.
+        [request setValue:nil forHTTPHeaderField:@"If-None-Match"];
+        [request setValue:nil forHTTPHeaderField:@"If-Modified-Since"];
+    }
+}
+
+- (BOOL)verify:(NSError **)error {
+    if (!_digest || _encoded) {
+        return YES;
+    }
+    // Read the expected digests, keyed by algorithm name.
+    NSMutableDictionary *expected = [NSMutableDictionary new];
+    for (NSString *item in [_digest componentsSeparatedByString:@","]) {
+        NSRange range = [item rangeOfString:@"="];
+        if (range.location == NSNotFound) {
+            continue;
+        }
+        NSCharacterSet *trim = [NSCharacterSet whitespaceCharacterSet];
+        NSString *algorithm = [[[item substringToIndex:range.location] stringByTrimmingCharactersInSet:trim] lowercaseString];
+        // Repr-Digest values are structured field byte sequences, i.e. base64 between colons.
+        NSString *value = [[item substringFromIndex:range.location + 1] stringByTrimmingCharactersInSet:trim];
+        value = [value stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@":"]];
+        NSData *digest = [[NSData alloc] initWithBase64EncodedString:value options:0];
+        if (digest) {
+            expected[algorithm] = digest;
+        }
+    }
+    NSData *sha256 = expected[@"sha-256"], *md5 = expected[@"md5"];
+    if (!(sha256 || md5)) {
+        // No supported algorithm.
+        return YES;
+    }
+    CC_SHA256_CTX sha256Ctx;
+    CC_MD5_CTX md5Ctx;
+    CC_SHA256_Init(&sha256Ctx);
+    CC_MD5_Init(&md5Ctx);
+    NSInputStream *input = [NSInputStream inputStreamWithFileAtPath:_path];
+    [input open];
+    NSMutableData *buffer = [NSMutableData dataWithLength:DecodeBufferSize];
+    NSInteger length;
+    while ((length = [input read:buffer.mutableBytes maxLength:DecodeBufferSize]) > 0) {
+        if (sha256) {
+            CC_SHA256_Update(&sha256Ctx, buffer.bytes, (CC_LONG)length);
+        }
+        else {
+            CC_MD5_Update(&md5Ctx, buffer.bytes, (CC_LONG)length);
+        }
+    }
+    [input close];
+    BOOL ok = (length == 0);
+    if (ok && sha256) {
+        unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+        CC_SHA256_Final(digest, &sha256Ctx);
+        ok = [sha256 isEqualToData:[NSData dataWithBytes:digest length:CC_SHA256_DIGEST_LENGTH]];
+    }
+    else if (ok) {
+        unsigned char digest[CC_MD5_DIGEST_LENGTH];
+        CC_MD5_Final(digest, &md5Ctx);
+        ok = [md5 isEqualToData:[NSData dataWithBytes:digest length:CC_MD5_DIGEST_LENGTH]];
+    }
+    if (!ok && error) {
+        *error = [NSError errorWithDomain:NSURLErrorDomain
+                                     code:NSURLErrorCannotDecodeContentData
+                                 userInfo:@{ NSLocalizedDescriptionKey: @"Downloaded content doesn't match the server checksum" }];
+    }
+    return ok;
+}
+
+- (void)close {
+    [_fileHandle closeFile];
+    _fileHandle = nil;
+}
+
+- (void)discard {
+    [self close];
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    [fileManager removeItemAtPath:_path error:nil];
+    [fileManager removeItemAtPath:_infoPath error:nil];
+}
+
+#pragma mark - IFHTTPClientDataReceiver
+
+- (void)receiveResponse:(NSHTTPURLResponse *)response {
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSDictionary *headers = response.allHeaderFields;
+    NSString *etag = headers[@"Etag"] ? headers[@"Etag"] : headers[@"ETag"];
+    NSString *contentEncoding = headers[@"Content-Encoding"];
+    contentEncoding = [[contentEncoding stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] lowercaseString];
+    _encoded = [contentEncoding length] > 0 && ![@"identity" isEqualToString:contentEncoding];
+    if (response.statusCode == 206) {
+        // Check that the partial content starts where the partial download ends, and that it is
+        // part of the same version of the resource as the partial download.
+        NSString *contentRange = headers[@"Content-Range"];
+        NSString *expectedRange = [NSString stringWithFormat:@"bytes %llu-", _offset];
+        BOOL sameVersion = !(_etag && etag) || [_etag isEqualToString:etag];
+        if (_offset == 0 || ![contentRange hasPrefix:expectedRange] || !sameVersion) {
+            NSString *description = [NSString stringWithFormat:@"Unexpected content range: %@ (%@)", contentRange, etag];
+            _error = [NSError errorWithDomain:NSURLErrorDomain
+                                         code:NSURLErrorCannotParseResponse
+                                     userInfo:@{ NSLocalizedDescriptionKey: description }];
+            [self discard];
+            return;
+        }
+        _fileHandle = [NSFileHandle fileHandleForWritingAtPath:_path];
+        [_fileHandle seekToFileOffset:_offset];
+        // A checksum of the full resource may also be sent with the remainder.
+        NSString *digest = headers[@"Repr-Digest"] ? headers[@"Repr-Digest"] : headers[@"Digest"];
+        if (digest) {
+            _digest = digest;
+        }
+    }
+    else if (response.statusCode == 200) {
+        // Full content; start the download from the beginning.
+        [fileManager createDirectoryAtPath:[_path stringByDeletingLastPathComponent]
+               withIntermediateDirectories:YES
+                                attributes:nil
+                                     error:nil];
+        [fileManager createFileAtPath:_path contents:nil attributes:nil];
+        _fileHandle = [NSFileHandle fileHandleForWritingAtPath:_path];
+        [fileManager removeItemAtPath:_infoPath error:nil];
+        if (_encoded && ![NativeContentEncodings containsObject:contentEncoding]) {
+            // The content is written as sent, and is only decoded once complete; it can't be resumed
+            // by a range request for the unencoded content, so no resume info is recorded.
+            return;
+        }
+        // Record the URL and validators, so that the download can be resumed if interrupted. Natively
+        // decoded content is received as the unencoded representation, so can be resumed by a range
+        // request for unencoded content.
+        NSMutableDictionary *info = [NSMutableDictionary new];
+        info[@"url"] = _url.absoluteString;
+        if (etag) {
+            info[@"etag"] = etag;
+        }
+        // Record any checksum of the resource, so that a resumed download can be checked once complete.
+        // Checksums of encoded content don't apply to the decoded content, so aren't recorded.
+        _digest = headers[@"Repr-Digest"] ? headers[@"Repr-Digest"] : headers[@"Digest"];
+        if (!_digest && headers[@"Content-MD5"]) {
+            _digest = [NSString stringWithFormat:@"md5=%@", headers[@"Content-MD5"]];
+        }
+        if (_digest && !_encoded) {
+            info[@"digest"] = _digest;
+        }
+        if (headers[@"Last-Modified"]) {
+            info[@"lastModified"] = headers[@"Last-Modified"];
+        }
+        [info writeToFile:_infoPath atomically:YES];
+    }
+    // Any other response body isn't written to file.
+}
+
+- (void)receiveData:(NSData *)data {
+    [_fileHandle writeData:data];
+}
+
+@end
+
 @implementation IFHTTPClient
 
++ (void)initialize {
+    // The URL loading system only decodes br (Brotli) content from iOS 11.
+    if ([self isBrotliNative]) {
+        NativeContentEncodings = [NSSet setWithObjects:@"gzip", @"x-gzip", @"deflate", @"br", nil];
+    }
+    else {
+        NativeContentEncodings = [NSSet setWithObjects:@"gzip", @"x-gzip", @"deflate", nil];
+    }
+}
+
++ (BOOL)isBrotliNative {
+    NSOperatingSystemVersion version = { .majorVersion = 11, .minorVersion = 0, .patchVersion = 0 };
+    return [[NSProcessInfo processInfo] isOperatingSystemAtLeastVersion:version];
+}
+
++ (NSString *)nativeAcceptEncodings {
+    return [self isBrotliNative] ? @"br, gzip" : @"gzip";
+}
+
+- (id)init {
+    return [self initWithNSURLSessionTaskDelegate:nil];
+}
+
 - (id)initWithNSURLSessionTaskDelegate:(id<NSURLSessionDataDelegate>)sessionTaskDelegate {
     self = [super init];
     if (self) {
         _sessionTaskDelegate = sessionTaskDelegate;
+        _callbackQueue = [NSOperationQueue new];
+        _callbackQueue.name = @"IFHTTPClient.callbacks";
+        _callbackQueue.maxConcurrentOperationCount = 1;
+        // Streamed data is delivered on a separate queue, so that processing of large streamed
+        // responses doesn't hold up completion of other requests.
+        _streamQueue = [NSOperationQueue new];
+        _streamQueue.name = @"IFHTTPClient.stream";
+        _streamQueue.maxConcurrentOperationCount = 1;
+        _maxConnectionsPerHost = 4;
+        _inflightRequests = [NSMutableDictionary new];
+        _metrics = [IFHTTPMetricsRecorder new];
+        _contentDecoders = [NSMutableDictionary new];
     }
     return self;
 }
 
+- (void)dealloc {
+    // The session retains its delegate until invalidated.
+    [_session finishTasksAndInvalidate];
+}
+
+- (void)registerContentDecoder:(IFHTTPContentDecoderFactory)factory forEncoding:(NSString *)encoding {
+    @synchronized (_contentDecoders) {
+        _contentDecoders[[encoding lowercaseString]] = factory;
+    }
+}
+
 - (QPromise *)get:(NSString *)url {
     return [self get:url data:nil options:nil];
 }
@@ -117,28 +657,73 @@ NSURL *makeURL(NSString *url, NSDictionary *params);
 }
 
 - (QPromise *)get:(NSString *)url data:(NSDictionary *)data options:(NSDictionary *)options {
+    NSURL *nsurl = makeURL(url, data);
+    NSString *key = makeRequestKey(@"GET", nsurl, options);
     return [self submitAction:^QPromise *{
         QPromise *promise = [QPromise new];
         // Send request.
-        NSURL *nsurl = makeURL(url, data);
         NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:nsurl
                                                                cachePolicy:NSURLRequestUseProtocolCachePolicy
                                                            timeoutInterval:60];
         [self setOptions:options onRequest:request];
-        NSURLSession *session = [self makeSession];
-        NSURLSessionDataTask *task = [session dataTaskWithRequest:request
-                                                completionHandler:
+        NSURLSession *session = [self session];
+        __block NSURLSessionDataTask *task = nil;
+        task = [session dataTaskWithRequest:request
+                          completionHandler:
         ^(NSData * _Nullable responseData, NSURLResponse * _Nullable response, NSError * _Nullable error) {
+            IFHTTPRequestMetrics *metrics = [self takeMetricsForTask:task];
             if (error) {
                 [promise reject:error];
+                return;
             }
-            else {
-                [promise resolve:[[IFHTTPClientResponse alloc] initWithHTTPResponse:response data:responseData]];
+            NSError *decodeError = nil;
+            NSData *data = [self decodeData:responseData forResponse:response error:&decodeError];
+            if (responseData && !data) {
+                [promise reject:makeDecodingError(decodeError)];
+                return;
             }
+            IFHTTPClientResponse *httpResponse = [[IFHTTPClientResponse alloc] initWithHTTPResponse:response data:data];
+            httpResponse.metrics = metrics;
+            [promise resolve:httpResponse];
         }];
         [task resume];
         return promise;
-    }];
+    } forURL:nsurl coalescingWithKey:key];
+}
+
+- (QPromise *)get:(NSString *)url data:(NSDictionary *)data options:(NSDictionary *)options receiver:(id<IFHTTPClientDataReceiver>)receiver {
+    NSURL *nsurl = makeURL(url, data);
+    return [self submitAction:^QPromise *{
+        QPromise *promise = [QPromise new];
+        NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:nsurl
+                                                               cachePolicy:NSURLRequestUseProtocolCachePolicy
+                                                           timeoutInterval:60];
+        [self setOptions:options onRequest:request];
+        IFHTTPValidatorStore *validatorStore = _validatorStore;
+        NSString *cachedLocation = options[IFHTTPClientRequestOptionCachedLocation];
+        if (!(validatorStore && cachedLocation)) {
+            [self startStreamedRequest:request receiver:receiver decodeContent:YES promise:promise];
+            return promise;
+        }
+        // Make the request conditional, and record the validators of a successful response.
+        NSDictionary *headers = [validatorStore conditionalHeadersForURL:nsurl location:cachedLocation];
+        for (NSString *name in headers) {
+            [request setValue:headers[name] forHTTPHeaderField:name];
+        }
+        QPromise *requestPromise = [QPromise new];
+        [self startStreamedRequest:request receiver:receiver decodeContent:YES promise:requestPromise];
+        requestPromise.then((id)^(IFHTTPClientResponse *response) {
+            if (response.httpResponse.statusCode == 200) {
+                [validatorStore recordValidatorsFromResponse:response.httpResponse forURL:nsurl location:cachedLocation];
+            }
+            [promise resolve:response];
+            return nil;
+        })
+        .fail(^(id error) {
+            [promise reject:error];
+        });
+        return promise;
+    } forURL:nsurl];
 }
 
 - (QPromise *)getFile:(NSString *)url {
@@ -150,27 +735,73 @@ NSURL *makeURL(NSString *url, NSDictionary *params);
 }
 
 - (QPromise *)getFile:(NSString *)url data:(NSDictionary *)data options:(NSDictionary *)options {
+    NSURL *fileURL = makeURL(url, data);
+    // Note that file and data GETs of the same URL are keyed separately, as they resolve differently.
+    NSString *key = makeRequestKey(@"GET file", fileURL, options);
     return [self submitAction:^QPromise *{
         QPromise *promise = [QPromise new];
-        NSURL *fileURL = makeURL(url, data);
         NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:fileURL
                                                                cachePolicy:NSURLRequestUseProtocolCachePolicy
                                                            timeoutInterval:60];
         [self setOptions:options onRequest:request];
-        NSURLSession *session = [self makeSession];
-        NSURLSessionDownloadTask *task = [session downloadTaskWithRequest:request
-                                                        completionHandler:
+        // Check for validators from a previous download of the same URL.
+        IFHTTPValidatorStore *validatorStore = _validatorStore;
+        NSString *cachedLocation = options[IFHTTPClientRequestOptionCachedLocation];
+        if (validatorStore && cachedLocation) {
+            NSDictionary *headers = [validatorStore conditionalHeadersForURL:fileURL location:cachedLocation];
+            for (NSString *name in headers) {
+                [request setValue:headers[name] forHTTPHeaderField:name];
+            }
+        }
+        NSString *resumePath = options[IFHTTPClientRequestOptionResumePath];
+        if (resumePath) {
+            [self getFileWithRequest:request resumePath:resumePath cachedLocation:cachedLocation promise:promise];
+            return promise;
+        }
+        NSURLSession *session = [self session];
+        __block NSURLSessionDownloadTask *task = nil;
+        task = [session downloadTaskWithRequest:request
+                              completionHandler:
         ^(NSURL * _Nullable location, NSURLResponse * _Nullable response, NSError * _Nullable error) {
+            IFHTTPRequestMetrics *metrics = [self takeMetricsForTask:task];
             if (error) {
                 [promise reject:error];
+                return;
             }
-            else {
-                [promise resolve:[[IFHTTPClientResponse alloc] initWithHTTPResponse:response downloadLocation:location]];
+            NSInteger statusCode = ((NSHTTPURLResponse *)response).statusCode;
+            NSURL *downloadLocation = location;
+            if (statusCode == 200) {
+                NSError *decodeError = nil;
+                location = [self decodeFileAtURL:downloadLocation forResponse:response error:&decodeError];
+                if (!location) {
+                    [promise reject:makeDecodingError(decodeError)];
+                    return;
+                }
+            }
+            if (validatorStore && cachedLocation) {
+                if (statusCode == 304) {
+                    // Content not modified; resolve with the previously downloaded content.
+                    location = [NSURL fileURLWithPath:cachedLocation];
+                }
+                else if (statusCode == 200) {
+                    [validatorStore recordValidatorsFromResponse:(NSHTTPURLResponse *)response
+                                                          forURL:fileURL
+                                                        location:cachedLocation];
+                }
+            }
+            IFHTTPClientResponse *httpResponse = [[IFHTTPClientResponse alloc] initWithHTTPResponse:response
+                                                                                   downloadLocation:location];
+            httpResponse.metrics = metrics;
+            [promise resolve:httpResponse];
+            // Decoded content is written to a temporary file, which (like the original download) is
+            // only available while the promise resolves.
+            if (statusCode == 200 && ![location isEqual:downloadLocation]) {
+                [[NSFileManager defaultManager] removeItemAtURL:location error:nil];
             }
         }];
         [task resume];
         return promise;
-    }];
+    } forURL:fileURL coalescingWithKey:key];
 }
 
 - (QPromise *)post:(NSString *)url data:(NSDictionary *)data {
@@ -178,10 +809,10 @@ NSURL *makeURL(NSString *url, NSDictionary *params);
 }
 
 - (QPromise *)post:(NSString *)url data:(NSDictionary *)data options:(NSDictionary *)options {
+    // Build URL.
+    NSURL *nsURL = [NSURL URLWithString:url];
     return [self submitAction:^QPromise *{
         QPromise *promise = [QPromise new];
-        // Build URL.
-        NSURL *nsURL = [NSURL URLWithString:url];
         // Send request.
         NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:nsURL
                                                                cachePolicy:NSURLRequestUseProtocolCachePolicy
@@ -201,19 +832,28 @@ NSURL *makeURL(NSString *url, NSDictionary *params);
             NSString *body = [queryItems componentsJoinedByString:@"&"];
             request.HTTPBody = [body dataUsingEncoding:NSUTF8StringEncoding];
         }
-        NSURLSession *session = [self makeSession];
-        NSURLSessionDataTask *task = [session dataTaskWithRequest:request
+        NSURLSession *session = [self session];
+        __block NSURLSessionDataTask *task = nil;
+        task = [session dataTaskWithRequest:request
             completionHandler:^(NSData * _Nullable responseData, NSURLResponse * _Nullable response, NSError * _Nullable error) {
+                IFHTTPRequestMetrics *metrics = [self takeMetricsForTask:task];
                 if (error) {
                     [promise reject:error];
+                    return;
                 }
-                else {
-                    [promise resolve:[[IFHTTPClientResponse alloc] initWithHTTPResponse:response data:responseData]];
+                NSError *decodeError = nil;
+                NSData *data = [self decodeData:responseData forResponse:response error:&decodeError];
+                if (responseData && !data) {
+                    [promise reject:makeDecodingError(decodeError)];
+                    return;
                 }
+                IFHTTPClientResponse *httpResponse = [[IFHTTPClientResponse alloc] initWithHTTPResponse:response data:data];
+                httpResponse.metrics = metrics;
+                [promise resolve:httpResponse];
             }];
         [task resume];
         return promise;
-    }];
+    } forURL:nsURL];
 }
 
 - (QPromise *)submit:(NSString *)method url:(NSString *)url data:(NSDictionary *)data {
@@ -223,9 +863,109 @@ NSURL *makeURL(NSString *url, NSDictionary *params);
     return [self get:url data:data];
 }
 
+- (NSUInteger)coalescedRequestCount {
+    return _metrics.coalescedRequestCount;
+}
+
 #pragma mark - Private methods
 
+- (void)startStreamedRequest:(NSURLRequest *)request
+                    receiver:(id<IFHTTPClientDataReceiver>)receiver
+               decodeContent:(BOOL)decodeContent
+                     promise:(QPromise *)promise {
+    // Streamed requests need their own task delegate, to receive response data as it arrives.
+    IFHTTPClientStreamTaskDelegate *delegate = [[IFHTTPClientStreamTaskDelegate alloc] initWithReceiver:receiver
+                                                                                                  queue:_streamQueue
+                                                                                                promise:promise];
+    if (decodeContent) {
+        delegate.decodingClient = self;
+    }
+    NSURLSession *session = [self session];
+    NSURLSessionDataTask *task = [session dataTaskWithRequest:request];
+    [(IFHTTPClientSessionDelegate *)session.delegate setStreamTaskDelegate:delegate forTask:task];
+    [task resume];
+}
+
+// TODO: Test against a stub server which drops the connection part way through a download, covering
+// 206 resumes, If-Range mismatches (200), 416 and 5xx responses, and checksum verification.
+- (void)getFileWithRequest:(NSMutableURLRequest *)request
+                resumePath:(NSString *)resumePath
+            cachedLocation:(NSString *)cachedLocation
+                   promise:(QPromise *)promise {
+    NSURL *fileURL = request.URL;
+    IFHTTPValidatorStore *validatorStore = _validatorStore;
+    IFHTTPClientFileReceiver *receiver = [[IFHTTPClientFileReceiver alloc] initWithPath:resumePath url:fileURL];
+    [receiver prepareRequest:request];
+    QPromise *requestPromise = [QPromise new];
+    // Note that content in an encoding not decoded by the URL loading system (e.g. zstd) is written
+    // to the partial download as sent, and is decoded once the download completes.
+    [self startStreamedRequest:request receiver:receiver decodeContent:NO promise:requestPromise];
+    requestPromise.then((id)^(IFHTTPClientResponse *requestResponse) {
+        [receiver close];
+        if (receiver.error) {
+            [promise reject:receiver.error];
+            return nil;
+        }
+        NSHTTPURLResponse *response = requestResponse.httpResponse;
+        NSURL *location = nil;
+        NSInteger statusCode = response.statusCode;
+        if (statusCode == 200 || statusCode == 206) {
+            // Check the completed download against any checksum supplied by the server.
+            NSError *verifyError = nil;
+            if (![receiver verify:&verifyError]) {
+                [receiver discard];
+                [promise reject:verifyError];
+                return nil;
+            }
+            if (statusCode == 206) {
+                // The partial download is now complete; present the result as a full response.
+                response = [[NSHTTPURLResponse alloc] initWithURL:response.URL
+                                                       statusCode:200
+                                                      HTTPVersion:@"HTTP/1.1"
+                                                     headerFields:response.allHeaderFields];
+            }
+            NSError *decodeError = nil;
+            location = [self decodeFileAtURL:[NSURL fileURLWithPath:resumePath] forResponse:response error:&decodeError];
+            if (!location) {
+                [receiver discard];
+                [promise reject:makeDecodingError(decodeError)];
+                return nil;
+            }
+            if (validatorStore && cachedLocation) {
+                [validatorStore recordValidatorsFromResponse:response forURL:fileURL location:cachedLocation];
+            }
+        }
+        else if (statusCode == 304 && cachedLocation) {
+            // Content not modified; resolve with the previously downloaded content.
+            location = [NSURL fileURLWithPath:cachedLocation];
+        }
+        IFHTTPClientResponse *fileResponse = [[IFHTTPClientResponse alloc] initWithHTTPResponse:response downloadLocation:location];
+        fileResponse.metrics = requestResponse.metrics;
+        [promise resolve:fileResponse];
+        if (statusCode == 200 || statusCode == 206 || statusCode == 304 || statusCode == 412 || statusCode == 416) {
+            // The download has either completed and been processed, or can't be resumed.
+            [receiver discard];
+        }
+        // Otherwise (e.g. a transient server error or rate limit response) keep the partial download,
+        // so that it can be resumed by a later request.
+        if (location && ![location.path isEqualToString:resumePath] && ![location.path isEqualToString:cachedLocation]) {
+            // Remove the temporary decoded content file.
+            [[NSFileManager defaultManager] removeItemAtURL:location error:nil];
+        }
+        return nil;
+    })
+    .fail(^(id error) {
+        // Keep the partial download, so that it can be resumed by a later request.
+        [receiver close];
+        [promise reject:error];
+    });
+}
+
 - (void)setOptions:(NSDictionary *)options onRequest:(NSMutableURLRequest *)request {
+    NSString *authorization = [_authorizationProvider authorizationHeaderForURL:request.URL];
+    if (authorization) {
+        [request setValue:authorization forHTTPHeaderField:@"Authorization"];
+    }
     if (options) {
         NSString *accept = options[IFHTTPClientRequestOptionAccept];
         if (accept) {
@@ -238,19 +978,167 @@ NSURL *makeURL(NSString *url, NSDictionary *params);
     }
 }
 
-- (QPromise *)submitAction:(IFHTTPClientAction)action {
+- (QPromise *)submitAction:(IFHTTPClientAction)action forURL:(NSURL *)url {
+    IFHTTPRateGovernor *rateGovernor = _rateGovernor;
+    if (rateGovernor) {
+        return [rateGovernor submitRequest:action forHost:url.host];
+    }
     return action();
 }
 
-- (NSURLSession *)makeSession {
-    if (_sessionTaskDelegate) {
-        NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
-        NSOperationQueue *operationQueue = [NSOperationQueue mainQueue];
-        return [NSURLSession sessionWithConfiguration:configuration
-                                             delegate:_sessionTaskDelegate
-                                        delegateQueue:operationQueue];
+- (QPromise *)submitAction:(IFHTTPClientAction)action forURL:(NSURL *)url coalescingWithKey:(NSString *)key {
+    QPromise *promise;
+    @synchronized (_inflightRequests) {
+        promise = _inflightRequests[key];
+        if (promise) {
+            [_metrics recordCoalescedRequest];
+            return promise;
+        }
+        promise = [self submitAction:action forURL:url];
+        _inflightRequests[key] = promise;
+    }
+    // Remove the request from the in-flight list once it completes.
+    NSMutableDictionary *inflightRequests = _inflightRequests;
+    void (^complete)(void) = ^() {
+        @synchronized (inflightRequests) {
+            if (inflightRequests[key] == promise) {
+                [inflightRequests removeObjectForKey:key];
+            }
+        }
+    };
+    promise.then((id)^(id result) {
+        complete();
+        return nil;
+    })
+    .fail(^(id error) {
+        complete();
+    });
+    return promise;
+}
+
+- (IFHTTPRequestMetrics *)takeMetricsForTask:(NSURLSessionTask *)task {
+    return [(IFHTTPClientSessionDelegate *)[self session].delegate takeMetricsForTask:task];
+}
+
+- (id<IFHTTPContentDecoder>)contentDecoderForResponse:(NSURLResponse *)response {
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) {
+        return nil;
+    }
+    NSString *encoding = [(NSHTTPURLResponse *)response valueForHTTPHeaderField:@"Content-Encoding"];
+    encoding = [[encoding stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] lowercaseString];
+    if ([encoding length] == 0 || [NativeContentEncodings containsObject:encoding]) {
+        return nil;
+    }
+    IFHTTPContentDecoderFactory factory;
+    @synchronized (_contentDecoders) {
+        factory = _contentDecoders[encoding];
+    }
+    return factory ? factory() : nil;
+}
+
+- (NSData *)decodeData:(NSData *)data forResponse:(NSURLResponse *)response error:(NSError **)error {
+    id<IFHTTPContentDecoder> decoder = [self contentDecoderForResponse:response];
+    if (!(decoder && data)) {
+        return data;
+    }
+    NSMutableData *result = [NSMutableData new];
+    NSData *decoded = [decoder decodeData:data error:error];
+    if (!decoded) {
+        return nil;
+    }
+    [result appendData:decoded];
+    decoded = [decoder finish:error];
+    if (!decoded) {
+        return nil;
+    }
+    [result appendData:decoded];
+    return result;
+}
+
+- (NSURL *)decodeFileAtURL:(NSURL *)location forResponse:(NSURLResponse *)response error:(NSError **)error {
+    id<IFHTTPContentDecoder> decoder = [self contentDecoderForResponse:response];
+    if (!(decoder && location)) {
+        return location;
+    }
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *decodedPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    [fileManager createFileAtPath:decodedPath contents:nil attributes:nil];
+    NSFileHandle *output = [NSFileHandle fileHandleForWritingAtPath:decodedPath];
+    NSInputStream *input = [NSInputStream inputStreamWithURL:location];
+    [input open];
+    // Decode the file in chunks, to avoid loading the full file into memory.
+    NSMutableData *buffer = [NSMutableData dataWithLength:DecodeBufferSize];
+    BOOL ok = (output != nil);
+    while (ok) {
+        NSInteger length = [input read:buffer.mutableBytes maxLength:DecodeBufferSize];
+        if (length < 0) {
+            *error = input.streamError;
+            ok = NO;
+        }
+        else if (length == 0) {
+            break;
+        }
+        else {
+            NSData *decoded = [decoder decodeData:[buffer subdataWithRange:NSMakeRange(0, length)] error:error];
+            if (decoded) {
+                [output writeData:decoded];
+            }
+            ok = (decoded != nil);
+        }
+    }
+    if (ok) {
+        NSData *decoded = [decoder finish:error];
+        if (decoded) {
+            [output writeData:decoded];
+        }
+        ok = (decoded != nil);
+    }
+    [input close];
+    [output closeFile];
+    if (!ok) {
+        [fileManager removeItemAtPath:decodedPath error:nil];
+        return nil;
+    }
+    return [NSURL fileURLWithPath:decodedPath];
+}
+
+- (NSURLSession *)session {
+    @synchronized (self) {
+        if (!_session) {
+            // Note that a single session is used for all requests, so that connections (and TLS sessions)
+            // can be reused between requests.
+            // TODO: Benchmark against a local HTTPS stand-in server, reporting requests/sec and TLS
+            // handshake counts; this needs a benchmark target, which the pod doesn't yet have.
+            NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+            if (_maxConnectionsPerHost > 0) {
+                configuration.HTTPMaximumConnectionsPerHost = _maxConnectionsPerHost;
+            }
+            IFHTTPClientSessionDelegate *delegate = [[IFHTTPClientSessionDelegate alloc] initWithClient:self];
+            _session = [NSURLSession sessionWithConfiguration:configuration
+                                                     delegate:delegate
+                                                delegateQueue:_callbackQueue];
+        }
+        return _session;
+    }
+}
+
+NSString *makeRequestKey(NSString *method, NSURL *url, NSDictionary *options) {
+    NSMutableString *key = [NSMutableString stringWithFormat:@"%@ %@", method, url.absoluteString];
+    // Options are appended in key order, so that equal option sets always produce the same key.
+    NSArray *names = [[options allKeys] sortedArrayUsingSelector:@selector(compare:)];
+    for (NSString *name in names) {
+        [key appendFormat:@" %@=%@", name, options[name]];
+    }
+    return key;
+}
+
+NSError *makeDecodingError(NSError *error) {
+    if (error) {
+        return error;
     }
-    return [NSURLSession sharedSession];
+    return [NSError errorWithDomain:NSURLErrorDomain
+                               code:NSURLErrorCannotDecodeContentData
+                           userInfo:@{ NSLocalizedDescriptionKey: @"Unable to decode response content" }];
 }
 
 NSURL *makeURL(NSString *url, NSDictionary *params) {
@@ -0,0 +1,98 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * Network timing metrics for a single HTTP request.
+ * Derived from the URL session's task metrics. Phase durations are in seconds, and are negative
+ * when the phase didn't occur (e.g. no DNS lookup or TLS handshake on a reused connection).
+ */
+@interface IFHTTPRequestMetrics : NSObject
+
+/// Initialize with the metrics collected for a completed session task.
+- (id _Nonnull)initWithTask:(NSURLSessionTask * _Nonnull)task metrics:(NSURLSessionTaskMetrics * _Nonnull)metrics;
+
+/// The requested URL.
+@property (nonatomic, strong, readonly) NSURL * _Nullable url;
+/// The endpoint name the metrics are aggregated under; the URL's host and path.
+@property (nonatomic, strong, readonly) NSString * _Nonnull endpoint;
+/// The time the request completed.
+@property (nonatomic, strong, readonly) NSDate * _Nonnull date;
+/// The duration of the DNS lookup.
+@property (nonatomic, assign, readonly) NSTimeInterval dnsTime;
+/// The duration of the connection setup, including any TLS handshake.
+@property (nonatomic, assign, readonly) NSTimeInterval connectTime;
+/// The duration of the TLS handshake.
+@property (nonatomic, assign, readonly) NSTimeInterval tlsTime;
+/// The time from the request starting to the first byte of the response being received.
+@property (nonatomic, assign, readonly) NSTimeInterval timeToFirstByte;
+/// The time from the first to the last byte of the response being received.
+@property (nonatomic, assign, readonly) NSTimeInterval transferTime;
+/// The total duration of the task, including any redirects and queueing.
+@property (nonatomic, assign, readonly) NSTimeInterval totalTime;
+/// The number of request body bytes sent.
+@property (nonatomic, assign, readonly) int64_t bytesSent;
+/// The number of response body bytes received.
+@property (nonatomic, assign, readonly) int64_t bytesReceived;
+/// Whether the request was made on a reused connection.
+@property (nonatomic, assign, readonly) BOOL reusedConnection;
+/// The network protocol used, e.g. http/1.1 or h2.
+@property (nonatomic, strong, readonly) NSString * _Nullable protocolName;
+
+/// Return the metrics as a JSON compatible dictionary.
+- (NSDictionary * _Nonnull)dictionaryRepresentation;
+
+@end
+
+/**
+ * A rolling record of HTTP request metrics.
+ * Keeps the metrics for recent requests, up to the sample limit and within the time window, and
+ * aggregates them per endpoint into timing histograms on demand. Thread safe.
+ */
+@interface IFHTTPMetricsRecorder : NSObject {
+    /// Recent request metrics, oldest first.
+    NSMutableArray *_samples;
+}
+
+/// The maximum number of request samples kept. Defaults to 1000.
+@property (nonatomic, assign) NSUInteger sampleLimit;
+/// The period, in seconds, over which samples are kept. Defaults to 600 (10 minutes).
+@property (nonatomic, assign) NSTimeInterval window;
+/// The number of requests coalesced with an identical in-flight request.
+@property (atomic, assign, readonly) NSUInteger coalescedRequestCount;
+
+/// Record the metrics for a request.
+- (void)recordMetrics:(IFHTTPRequestMetrics * _Nonnull)metrics;
+/// Record a request coalesced with an identical in-flight request.
+- (void)recordCoalescedRequest;
+
+/**
+ * Return a snapshot of the recorded metrics.
+ * The snapshot is a JSON compatible dictionary, with per-endpoint request counts, byte totals and
+ * histograms and percentiles for each request phase, under the endpoints key.
+ */
+- (NSDictionary * _Nonnull)snapshot;
+/// Return a snapshot of the recorded metrics as JSON data.
+- (NSData * _Nullable)snapshotJSONData;
+/// Write a snapshot of the recorded metrics to a JSON file. Returns NO if the file can't be written.
+- (BOOL)writeSnapshotToFile:(NSString * _Nonnull)path;
+/// Discard all recorded metrics.
+- (void)reset;
+
+@end
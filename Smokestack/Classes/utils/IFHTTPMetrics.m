@@ -0,0 +1,248 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import "IFHTTPMetrics.h"
+
+#define DefaultSampleLimit  (1000)
+#define DefaultWindow       (600)
+
+/// Histogram bucket upper bounds, in milliseconds.
+static NSArray *HistogramBuckets;
+
+/// Return the interval between two dates, or -1 if either date is missing.
+static NSTimeInterval IntervalBetween(NSDate *start, NSDate *end) {
+    if (start && end) {
+        return [end timeIntervalSinceDate:start];
+    }
+    return -1;
+}
+
+@implementation IFHTTPRequestMetrics
+
+- (id)initWithTask:(NSURLSessionTask *)task metrics:(NSURLSessionTaskMetrics *)metrics {
+    self = [super init];
+    if (self) {
+        _url = task.originalRequest.URL;
+        _endpoint = [NSString stringWithFormat:@"%@%@", _url.host ?: @"", _url.path ?: @""];
+        _date = [NSDate date];
+        // Use the final transaction, i.e. after any redirects.
+        NSURLSessionTaskTransactionMetrics *transaction = [metrics.transactionMetrics lastObject];
+        _dnsTime = IntervalBetween(transaction.domainLookupStartDate, transaction.domainLookupEndDate);
+        _connectTime = IntervalBetween(transaction.connectStartDate, transaction.connectEndDate);
+        _tlsTime = IntervalBetween(transaction.secureConnectionStartDate, transaction.secureConnectionEndDate);
+        _timeToFirstByte = IntervalBetween(transaction.requestStartDate, transaction.responseStartDate);
+        _transferTime = IntervalBetween(transaction.responseStartDate, transaction.responseEndDate);
+        _totalTime = metrics.taskInterval.duration;
+        _bytesSent = task.countOfBytesSent;
+        _bytesReceived = task.countOfBytesReceived;
+        _reusedConnection = transaction.reusedConnection;
+        _protocolName = transaction.networkProtocolName;
+    }
+    return self;
+}
+
+- (NSDictionary *)dictionaryRepresentation {
+    NSMutableDictionary *result = [NSMutableDictionary new];
+    result[@"url"] = _url.absoluteString ?: @"";
+    result[@"endpoint"] = _endpoint;
+    result[@"dns"] = @(_dnsTime);
+    result[@"connect"] = @(_connectTime);
+    result[@"tls"] = @(_tlsTime);
+    result[@"ttfb"] = @(_timeToFirstByte);
+    result[@"transfer"] = @(_transferTime);
+    result[@"total"] = @(_totalTime);
+    result[@"bytesSent"] = @(_bytesSent);
+    result[@"bytesReceived"] = @(_bytesReceived);
+    result[@"reusedConnection"] = @(_reusedConnection);
+    if (_protocolName) {
+        result[@"protocol"] = _protocolName;
+    }
+    return result;
+}
+
+@end
+
+@interface IFHTTPMetricsRecorder ()
+
+/// Remove samples outside of the sample limit or time window.
+- (void)pruneSamples;
+/// Return a summary of a list of phase durations, in seconds.
+- (NSDictionary *)summarizeDurations:(NSArray *)durations;
+
+@end
+
+@implementation IFHTTPMetricsRecorder
+
++ (void)initialize {
+    HistogramBuckets = @[ @1, @5, @10, @25, @50, @100, @250, @500, @1000, @2500, @5000, @10000 ];
+}
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _samples = [NSMutableArray new];
+        _sampleLimit = DefaultSampleLimit;
+        _window = DefaultWindow;
+    }
+    return self;
+}
+
+- (void)recordMetrics:(IFHTTPRequestMetrics *)metrics {
+    @synchronized (_samples) {
+        [_samples addObject:metrics];
+        [self pruneSamples];
+    }
+}
+
+- (void)recordCoalescedRequest {
+    @synchronized (_samples) {
+        _coalescedRequestCount++;
+    }
+}
+
+- (NSDictionary *)snapshot {
+    NSArray *samples;
+    NSUInteger coalescedRequestCount;
+    @synchronized (_samples) {
+        [self pruneSamples];
+        samples = [_samples copy];
+        coalescedRequestCount = _coalescedRequestCount;
+    }
+    // Group samples by endpoint.
+    NSMutableDictionary *samplesByEndpoint = [NSMutableDictionary new];
+    for (IFHTTPRequestMetrics *sample in samples) {
+        NSMutableArray *endpointSamples = samplesByEndpoint[sample.endpoint];
+        if (!endpointSamples) {
+            endpointSamples = [NSMutableArray new];
+            samplesByEndpoint[sample.endpoint] = endpointSamples;
+        }
+        [endpointSamples addObject:sample];
+    }
+    NSArray *phases = @[ @"dns", @"connect", @"tls", @"ttfb", @"transfer", @"total" ];
+    NSMutableDictionary *endpoints = [NSMutableDictionary new];
+    for (NSString *endpoint in samplesByEndpoint) {
+        NSArray *endpointSamples = samplesByEndpoint[endpoint];
+        NSMutableDictionary *durations = [NSMutableDictionary new];
+        for (NSString *phase in phases) {
+            durations[phase] = [NSMutableArray new];
+        }
+        int64_t bytesSent = 0, bytesReceived = 0;
+        NSInteger reusedConnections = 0;
+        for (IFHTTPRequestMetrics *sample in endpointSamples) {
+            NSDictionary *values = [sample dictionaryRepresentation];
+            for (NSString *phase in phases) {
+                NSNumber *duration = values[phase];
+                // Negative durations indicate that the phase didn't occur.
+                if ([duration doubleValue] >= 0) {
+                    [durations[phase] addObject:duration];
+                }
+            }
+            bytesSent += sample.bytesSent;
+            bytesReceived += sample.bytesReceived;
+            if (sample.reusedConnection) {
+                reusedConnections++;
+            }
+        }
+        NSMutableDictionary *phaseSummaries = [NSMutableDictionary new];
+        for (NSString *phase in phases) {
+            phaseSummaries[phase] = [self summarizeDurations:durations[phase]];
+        }
+        endpoints[endpoint] = @{
+            @"count":               @([endpointSamples count]),
+            @"reusedConnections":   @(reusedConnections),
+            @"bytesSent":           @(bytesSent),
+            @"bytesReceived":       @(bytesReceived),
+            @"phases":              phaseSummaries
+        };
+    }
+    return @{
+        @"date":                    @([[NSDate date] timeIntervalSince1970]),
+        @"window":                  @(_window),
+        @"requestCount":            @([samples count]),
+        @"coalescedRequestCount":   @(coalescedRequestCount),
+        @"endpoints":               endpoints
+    };
+}
+
+- (NSData *)snapshotJSONData {
+    return [NSJSONSerialization dataWithJSONObject:[self snapshot] options:NSJSONWritingPrettyPrinted error:nil];
+}
+
+- (BOOL)writeSnapshotToFile:(NSString *)path {
+    NSData *data = [self snapshotJSONData];
+    return data && [data writeToFile:path atomically:YES];
+}
+
+- (void)reset {
+    @synchronized (_samples) {
+        [_samples removeAllObjects];
+        _coalescedRequestCount = 0;
+    }
+}
+
+#pragma mark - Private methods
+
+- (void)pruneSamples {
+    NSUInteger excess = [_samples count] > _sampleLimit ? [_samples count] - _sampleLimit : 0;
+    NSDate *windowStart = [NSDate dateWithTimeIntervalSinceNow:-_window];
+    while (excess < [_samples count] && [((IFHTTPRequestMetrics *)_samples[excess]).date compare:windowStart] == NSOrderedAscending) {
+        excess++;
+    }
+    if (excess > 0) {
+        [_samples removeObjectsInRange:NSMakeRange(0, excess)];
+    }
+}
+
+- (NSDictionary *)summarizeDurations:(NSArray *)durations {
+    NSUInteger count = [durations count];
+    if (count == 0) {
+        return @{ @"count": @0 };
+    }
+    NSArray *sorted = [durations sortedArrayUsingSelector:@selector(compare:)];
+    double total = 0;
+    // Histogram counts, with a final overflow bucket for durations above the largest bucket bound.
+    NSUInteger bucketCount = [HistogramBuckets count];
+    NSMutableArray *histogram = [NSMutableArray new];
+    for (NSUInteger i = 0; i <= bucketCount; i++) {
+        [histogram addObject:@0];
+    }
+    for (NSNumber *duration in sorted) {
+        double ms = [duration doubleValue] * 1000.0;
+        total += [duration doubleValue];
+        NSUInteger bucket = 0;
+        while (bucket < bucketCount && ms > [HistogramBuckets[bucket] doubleValue]) {
+            bucket++;
+        }
+        histogram[bucket] = @([histogram[bucket] integerValue] + 1);
+    }
+    NSMutableDictionary *buckets = [NSMutableDictionary new];
+    for (NSUInteger i = 0; i <= bucketCount; i++) {
+        NSString *label = i < bucketCount ? [NSString stringWithFormat:@"<=%@ms", HistogramBuckets[i]] : @">10000ms";
+        buckets[label] = histogram[i];
+    }
+    return @{
+        @"count":   @(count),
+        @"mean":    @(total / count),
+        @"p50":     sorted[(NSUInteger)((count - 1) * 0.5)],
+        @"p95":     sorted[(NSUInteger)((count - 1) * 0.95)],
+        @"max":     [sorted lastObject],
+        @"buckets": buckets
+    };
+}
+
+@end
@@ -0,0 +1,62 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <Q/Q.h>
+
+/// A governed request; starts the request and returns a promise which resolves once it completes.
+typedef QPromise * _Nonnull (^IFHTTPRateGovernorRequest) (void);
+
+/**
+ * A governor of HTTP request throughput.
+ * Requests are queued per host and started in submission order. Each host has a token bucket which
+ * limits its sustained request rate, whilst allowing short bursts of requests up to the bucket size.
+ * The number of requests in flight, both per host and in total, can also be limited. Whenever a
+ * request can be started, hosts with queued requests are served in round-robin order, so that a
+ * burst of requests to one host doesn't hold up requests to other hosts.
+ */
+@interface IFHTTPRateGovernor : NSObject {
+    /// A serial queue for accessing the governor's state.
+    dispatch_queue_t _queue;
+    /// Per-host request queues and token buckets, keyed by host name.
+    NSMutableDictionary *_hosts;
+    /// The names of hosts with queued requests, in the order they will next be served.
+    NSMutableArray *_hostOrder;
+    /// The total number of requests in flight.
+    NSInteger _activeCount;
+    /// Flag indicating whether a delayed dispatch of queued requests has been scheduled.
+    BOOL _dispatchScheduled;
+}
+
+/// The maximum sustained number of requests per second to a single host. Defaults to 0 (no limit).
+@property (nonatomic, assign) double requestsPerSecond;
+/// The number of requests which can be made to a single host in a burst. Defaults to 5.
+@property (nonatomic, assign) NSInteger burstSize;
+/// The maximum number of requests in flight to a single host. Defaults to 4; 0 means no limit.
+@property (nonatomic, assign) NSInteger maxConcurrentRequestsPerHost;
+/// The maximum number of requests in flight to all hosts. Defaults to 0 (no limit).
+@property (nonatomic, assign) NSInteger maxConcurrentRequests;
+
+/**
+ * Submit a request to the governor.
+ * The request is started once the host's limits allow. Returns a promise which resolves or rejects
+ * with the request's result.
+ */
+- (QPromise * _Nonnull)submitRequest:(IFHTTPRateGovernorRequest _Nonnull)request forHost:(NSString * _Nullable)host;
+
+@end
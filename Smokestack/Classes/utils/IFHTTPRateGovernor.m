@@ -0,0 +1,196 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import "IFHTTPRateGovernor.h"
+
+#define DefaultBurstSize                    (5)
+#define DefaultMaxConcurrentRequestsPerHost (4)
+
+/// A request queued with the governor.
+@interface IFHTTPRateGovernorItem : NSObject
+
+@property (nonatomic, copy) IFHTTPRateGovernorRequest request;
+@property (nonatomic, strong) QPromise *promise;
+
+@end
+
+/// A host's request queue and token bucket.
+@interface IFHTTPRateGovernorHost : NSObject
+
+/// Requests queued for the host.
+@property (nonatomic, strong) NSMutableArray *pending;
+/// The number of requests to the host in flight.
+@property (nonatomic, assign) NSInteger activeCount;
+/// The number of tokens currently in the host's bucket.
+@property (nonatomic, assign) double tokens;
+/// The time the bucket's tokens were last refilled.
+@property (nonatomic, assign) NSTimeInterval refillTime;
+
+@end
+
+@interface IFHTTPRateGovernor ()
+
+/// Start as many queued requests as the governor's limits allow. Called on the governor's queue.
+- (void)dispatchPendingRequests;
+/// Refill a host's token bucket at the specified time.
+- (void)refillTokensForHost:(IFHTTPRateGovernorHost *)host atTime:(NSTimeInterval)time;
+/// Start a queued request.
+- (void)startItem:(IFHTTPRateGovernorItem *)item forHost:(IFHTTPRateGovernorHost *)host;
+/// Schedule a dispatch of queued requests after a delay.
+- (void)scheduleDispatchAfter:(NSTimeInterval)delay;
+
+@end
+
+@implementation IFHTTPRateGovernorItem
+
+@end
+
+@implementation IFHTTPRateGovernorHost
+
+@end
+
+@implementation IFHTTPRateGovernor
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _queue = dispatch_queue_create("IFHTTPRateGovernor", DISPATCH_QUEUE_SERIAL);
+        _hosts = [NSMutableDictionary new];
+        _hostOrder = [NSMutableArray new];
+        _burstSize = DefaultBurstSize;
+        _maxConcurrentRequestsPerHost = DefaultMaxConcurrentRequestsPerHost;
+    }
+    return self;
+}
+
+- (QPromise *)submitRequest:(IFHTTPRateGovernorRequest)request forHost:(NSString *)hostName {
+    IFHTTPRateGovernorItem *item = [IFHTTPRateGovernorItem new];
+    item.request = request;
+    item.promise = [QPromise new];
+    if (!hostName) {
+        hostName = @"";
+    }
+    dispatch_async(_queue, ^{
+        IFHTTPRateGovernorHost *host = _hosts[hostName];
+        if (!host) {
+            // New hosts start with a full bucket.
+            host = [IFHTTPRateGovernorHost new];
+            host.pending = [NSMutableArray new];
+            host.tokens = MAX(_burstSize, 1);
+            host.refillTime = [NSDate timeIntervalSinceReferenceDate];
+            _hosts[hostName] = host;
+        }
+        [host.pending addObject:item];
+        if (![_hostOrder containsObject:hostName]) {
+            [_hostOrder addObject:hostName];
+        }
+        [self dispatchPendingRequests];
+    });
+    return item.promise;
+}
+
+#pragma mark - Private methods
+
+- (void)dispatchPendingRequests {
+    NSTimeInterval now = [NSDate timeIntervalSinceReferenceDate];
+    // The time until the next token becomes available to a host waiting on its rate limit.
+    NSTimeInterval nextTokenDelay = 0;
+    BOOL dispatched;
+    do {
+        dispatched = NO;
+        // Make one pass over the waiting hosts, starting at most one request for each host.
+        for (NSString *hostName in [_hostOrder copy]) {
+            if (_maxConcurrentRequests > 0 && _activeCount >= _maxConcurrentRequests) {
+                // Remaining requests will be dispatched as requests in flight complete.
+                return;
+            }
+            IFHTTPRateGovernorHost *host = _hosts[hostName];
+            if (_maxConcurrentRequestsPerHost > 0 && host.activeCount >= _maxConcurrentRequestsPerHost) {
+                continue;
+            }
+            if (_requestsPerSecond > 0) {
+                [self refillTokensForHost:host atTime:now];
+                if (host.tokens < 1.0) {
+                    NSTimeInterval delay = (1.0 - host.tokens) / _requestsPerSecond;
+                    if (nextTokenDelay == 0 || delay < nextTokenDelay) {
+                        nextTokenDelay = delay;
+                    }
+                    continue;
+                }
+                host.tokens -= 1.0;
+            }
+            IFHTTPRateGovernorItem *item = host.pending[0];
+            [host.pending removeObjectAtIndex:0];
+            // Move the host to the back of the line.
+            [_hostOrder removeObject:hostName];
+            if ([host.pending count] > 0) {
+                [_hostOrder addObject:hostName];
+            }
+            [self startItem:item forHost:host];
+            dispatched = YES;
+        }
+    }
+    while (dispatched);
+    if (nextTokenDelay > 0) {
+        [self scheduleDispatchAfter:nextTokenDelay];
+    }
+}
+
+- (void)refillTokensForHost:(IFHTTPRateGovernorHost *)host atTime:(NSTimeInterval)time {
+    double capacity = MAX(_burstSize, 1);
+    host.tokens = MIN(capacity, host.tokens + ((time - host.refillTime) * _requestsPerSecond));
+    host.refillTime = time;
+}
+
+- (void)startItem:(IFHTTPRateGovernorItem *)item forHost:(IFHTTPRateGovernorHost *)host {
+    _activeCount++;
+    host.activeCount++;
+    QPromise *promise = item.promise;
+    dispatch_queue_t queue = _queue;
+    // Release the request's slot and dispatch any waiting requests once the request completes.
+    void (^complete)(void) = ^() {
+        dispatch_async(queue, ^{
+            _activeCount--;
+            host.activeCount--;
+            [self dispatchPendingRequests];
+        });
+    };
+    item.request()
+    .then((id)^(id result) {
+        complete();
+        [promise resolve:result];
+        return nil;
+    })
+    .fail(^(id error) {
+        complete();
+        [promise reject:error];
+    });
+}
+
+- (void)scheduleDispatchAfter:(NSTimeInterval)delay {
+    if (_dispatchScheduled) {
+        return;
+    }
+    _dispatchScheduled = YES;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), _queue, ^{
+        _dispatchScheduled = NO;
+        [self dispatchPendingRequests];
+    });
+}
+
+@end
@@ -0,0 +1,53 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import <Foundation/Foundation.h>
+
+/**
+ * A persistent store of HTTP cache validators.
+ * Records the ETag and Last-Modified values returned with downloaded resources, together with the
+ * location the resource's content was stored at, so that later requests for the same resource can
+ * be made conditional. The store is saved as a property list file.
+ */
+@interface IFHTTPValidatorStore : NSObject {
+    /// The path to the store file.
+    NSString *_path;
+    /// The validators, keyed by URL.
+    NSMutableDictionary *_validators;
+}
+
+/// Initialize the store using the file at the specified path.
+- (id)initWithPath:(NSString *)path;
+
+/**
+ * Return conditional request headers for a URL whose content is stored at the specified location.
+ * Returns nil if no validators are recorded for the URL, or if the recorded location doesn't match
+ * or no longer exists.
+ */
+- (NSDictionary *)conditionalHeadersForURL:(NSURL *)url location:(NSString *)location;
+/**
+ * Record the validators returned with a response for a URL.
+ * The location is where the response content is (or will be) stored. Any previously recorded
+ * validators are removed if the response doesn't contain any validators.
+ */
+- (void)recordValidatorsFromResponse:(NSHTTPURLResponse *)response forURL:(NSURL *)url location:(NSString *)location;
+/// Remove any validators recorded for a URL.
+- (void)removeValidatorsForURL:(NSURL *)url;
+
+@end
@@ -0,0 +1,102 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+
+#import "IFHTTPValidatorStore.h"
+
+@interface IFHTTPValidatorStore ()
+
+/// Write the store to file.
+- (void)save;
+
+@end
+
+@implementation IFHTTPValidatorStore
+
+- (id)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        _path = path;
+        NSDictionary *validators = [NSDictionary dictionaryWithContentsOfFile:path];
+        _validators = validators ? [validators mutableCopy] : [NSMutableDictionary new];
+    }
+    return self;
+}
+
+- (NSDictionary *)conditionalHeadersForURL:(NSURL *)url location:(NSString *)location {
+    NSDictionary *validators;
+    @synchronized (self) {
+        validators = _validators[url.absoluteString];
+    }
+    if (!(validators && [location isEqualToString:validators[@"location"]])) {
+        return nil;
+    }
+    // The validators are only useful if the previously downloaded content is still available.
+    if (![[NSFileManager defaultManager] fileExistsAtPath:location]) {
+        return nil;
+    }
+    NSMutableDictionary *headers = [NSMutableDictionary new];
+    if (validators[@"etag"]) {
+        headers[@"If-None-Match"] = validators[@"etag"];
+    }
+    if (validators[@"lastModified"]) {
+        headers[@"If-Modified-Since"] = validators[@"lastModified"];
+    }
+    return headers;
+}
+
+- (void)recordValidatorsFromResponse:(NSHTTPURLResponse *)response forURL:(NSURL *)url location:(NSString *)location {
+    NSDictionary *headers = response.allHeaderFields;
+    // Note that header names are case insensitive, but allHeaderFields uses canonical names.
+    NSString *etag = headers[@"Etag"] ? headers[@"Etag"] : headers[@"ETag"];
+    NSString *lastModified = headers[@"Last-Modified"];
+    if (!(etag || lastModified) || !location) {
+        [self removeValidatorsForURL:url];
+        return;
+    }
+    NSMutableDictionary *validators = [NSMutableDictionary new];
+    validators[@"location"] = location;
+    if (etag) {
+        validators[@"etag"] = etag;
+    }
+    if (lastModified) {
+        validators[@"lastModified"] = lastModified;
+    }
+    @synchronized (self) {
+        _validators[url.absoluteString] = validators;
+        [self save];
+    }
+}
+
+- (void)removeValidatorsForURL:(NSURL *)url {
+    @synchronized (self) {
+        NSString *key = url.absoluteString;
+        if (_validators[key]) {
+            [_validators removeObjectForKey:key];
+            [self save];
+        }
+    }
+}
+
+- (void)save {
+    NSString *dir = [_path stringByDeletingLastPathComponent];
+    [[NSFileManager defaultManager] createDirectoryAtPath:dir withIntermediateDirectories:YES attributes:nil error:nil];
+    [_validators writeToFile:_path atomically:YES];
+}
+
+@end
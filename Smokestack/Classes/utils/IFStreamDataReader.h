@@ -0,0 +1,87 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * A handler for values read from a data stream.
+ * @param path  The value's location within the data, as a list of map keys and array indices.
+ * @param value The value.
+ */
+typedef void (^IFStreamDataReaderValueHandler) (NSArray * _Nonnull path, id _Nonnull value);
+
+/**
+ * An incremental reader for structured data.
+ * Data is passed to the reader in chunks, as it becomes available (e.g. as it arrives from the
+ * network), and is decoded as it is received. Values found at any of the reader's streamed paths
+ * are passed to the value handler as soon as they are fully decoded, and aren't retained in the
+ * reader's result; this allows large lists of records to be processed with a flat memory profile.
+ * All other values are assembled into the result in the normal way.
+ * This is an abstract class; use the readerForMIMEType: method to get a reader instance for a
+ * specific data format.
+ */
+@interface IFStreamDataReader : NSObject {
+    /// Buffered data not yet consumed by the reader.
+    NSMutableData *_buffer;
+    /// A stack of partially read container values (maps and arrays).
+    NSMutableArray *_stack;
+    /// The streamed paths, with each path split into its components.
+    NSArray *_streamedPathComponents;
+    /// The set of path lengths found in the streamed paths list.
+    NSIndexSet *_streamedPathLengths;
+}
+
+/**
+ * A list of dotted key paths whose values should be passed to the value handler.
+ * A path component of * will match any map key or array index, so for example
+ * db.*.* will match all items in all arrays in the map under the top-level db key.
+ */
+@property (nonatomic, strong) NSArray * _Nullable streamedPaths;
+/// A handler for values read from the streamed paths.
+@property (nonatomic, copy) IFStreamDataReaderValueHandler _Nullable valueHandler;
+/// The reader's result; only available once the reader has finished.
+@property (nonatomic, strong, readonly) id _Nullable result;
+/// The number of values passed to the value handler.
+@property (nonatomic, assign, readonly) NSUInteger streamedValueCount;
+
+/**
+ * Append data to the reader.
+ * Decodes as much of the data as possible. Values that are incomplete at the end of the data
+ * are buffered until the next data append. Returns NO if the data can't be decoded.
+ */
+- (BOOL)appendData:(NSData * _Nonnull)data error:(NSError * _Nullable * _Nullable)error;
+/**
+ * Finish reading.
+ * Should be called after all data has been appended; returns NO if the data is incomplete.
+ */
+- (BOOL)finish:(NSError * _Nullable * _Nullable)error;
+
+/// Return a reader for data of the specified MIME type, or nil if the type isn't supported.
++ (IFStreamDataReader * _Nullable)readerForMIMEType:(NSString * _Nullable)mimeType;
+
+@end
+
+/// A stream data reader for msgpack formatted data.
+@interface IFMessagePackStreamReader : IFStreamDataReader
+
+@end
+
+/// A stream data reader for JSON formatted data.
+@interface IFJSONStreamReader : IFStreamDataReader
+
+@end
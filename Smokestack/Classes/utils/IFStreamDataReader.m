@@ -0,0 +1,619 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import "IFStreamDataReader.h"
+
+#define IFStreamDataReaderErrorDomain   (@"IFStreamDataReader")
+#define NeedMoreData                    (0)
+#define ReadError                       (-1)
+
+/// A partially read container value.
+@interface IFStreamDataFrame : NSObject
+
+/// The container; an NSMutableDictionary or an NSMutableArray.
+@property (nonatomic, strong) id container;
+/// Flag indicating whether the container is a map.
+@property (nonatomic, assign) BOOL isMap;
+/// The key of the map entry currently being read.
+@property (nonatomic, strong) NSString *key;
+/// The number of values read into the container (including streamed values).
+@property (nonatomic, assign) NSInteger count;
+/// The number of values still to be read; -1 if not known in advance.
+@property (nonatomic, assign) NSInteger remaining;
+/// The container's location within the data.
+@property (nonatomic, strong) NSArray *path;
+/// Flag indicating that the container is part of a streamed value.
+@property (nonatomic, assign) BOOL streamed;
+
+@end
+
+@implementation IFStreamDataFrame
+
+@end
+
+@interface IFStreamDataReader ()
+
+/**
+ * Read the next token from the data.
+ * Returns the number of bytes consumed; or NeedMoreData if the data doesn't contain a complete
+ * token; or ReadError if the data can't be decoded.
+ * The final flag indicates that no more data will be appended.
+ */
+- (NSInteger)readToken:(const uint8_t *)bytes length:(NSUInteger)length final:(BOOL)final error:(NSError **)error;
+/// Start reading a container value.
+- (void)beginContainer:(BOOL)isMap remaining:(NSInteger)remaining;
+/// Complete the container value currently being read.
+- (BOOL)endContainer;
+/// Add a fully read value to the data.
+- (void)addValue:(id)value;
+/// Return the path for the next value in a container.
+- (NSArray *)pathForNextValueInFrame:(IFStreamDataFrame *)frame;
+/// Test whether a path matches one of the streamed paths.
+- (BOOL)isStreamedPath:(NSArray *)path;
+/// Read buffered data.
+- (BOOL)readBuffer:(BOOL)final error:(NSError **)error;
+/// Make a read error.
+- (NSError *)makeError:(NSString *)description;
+
+@end
+
+@implementation IFStreamDataReader
+
+- (id)init {
+    self = [super init];
+    if (self) {
+        _buffer = [NSMutableData new];
+        _stack = [NSMutableArray new];
+        _streamedPathComponents = @[];
+        _streamedPathLengths = [NSIndexSet indexSet];
+    }
+    return self;
+}
+
+- (void)setStreamedPaths:(NSArray *)streamedPaths {
+    _streamedPaths = streamedPaths;
+    NSMutableArray *components = [NSMutableArray new];
+    NSMutableIndexSet *lengths = [NSMutableIndexSet new];
+    for (NSString *path in streamedPaths) {
+        NSArray *pathComponents = [path componentsSeparatedByString:@"."];
+        [components addObject:pathComponents];
+        [lengths addIndex:[pathComponents count]];
+    }
+    _streamedPathComponents = components;
+    _streamedPathLengths = lengths;
+}
+
+- (BOOL)appendData:(NSData *)data error:(NSError **)error {
+    [_buffer appendData:data];
+    return [self readBuffer:NO error:error];
+}
+
+- (BOOL)finish:(NSError **)error {
+    if (![self readBuffer:YES error:error]) {
+        return NO;
+    }
+    if ([_buffer length] > 0 || [_stack count] > 0) {
+        if (error) {
+            *error = [self makeError:@"Unexpected end of data"];
+        }
+        return NO;
+    }
+    return YES;
+}
+
+- (BOOL)readBuffer:(BOOL)final error:(NSError **)error {
+    const uint8_t *bytes = [_buffer bytes];
+    NSUInteger length = [_buffer length];
+    NSUInteger offset = 0;
+    while (offset < length) {
+        NSInteger consumed = [self readToken:(bytes + offset) length:(length - offset) final:final error:error];
+        if (consumed == ReadError) {
+            return NO;
+        }
+        if (consumed == NeedMoreData) {
+            break;
+        }
+        offset += consumed;
+    }
+    // Discard consumed data from the buffer.
+    if (offset > 0) {
+        [_buffer replaceBytesInRange:NSMakeRange(0, offset) withBytes:NULL length:0];
+    }
+    return YES;
+}
+
+- (NSInteger)readToken:(const uint8_t *)bytes length:(NSUInteger)length final:(BOOL)final error:(NSError **)error {
+    // Subclasses must override this method.
+    if (error) {
+        *error = [self makeError:@"Unsupported data format"];
+    }
+    return ReadError;
+}
+
+- (void)beginContainer:(BOOL)isMap remaining:(NSInteger)remaining {
+    IFStreamDataFrame *parent = [_stack lastObject];
+    IFStreamDataFrame *frame = [IFStreamDataFrame new];
+    frame.isMap = isMap;
+    frame.container = isMap ? [NSMutableDictionary new] : [NSMutableArray new];
+    frame.remaining = remaining;
+    if (parent) {
+        frame.path = [self pathForNextValueInFrame:parent];
+        frame.streamed = parent.streamed || [self isStreamedPath:frame.path];
+    }
+    else {
+        frame.path = @[];
+        frame.streamed = NO;
+    }
+    [_stack addObject:frame];
+    // Containers with a known size of zero are complete as soon as they start.
+    if (remaining == 0) {
+        [self endContainer];
+    }
+}
+
+- (BOOL)endContainer {
+    IFStreamDataFrame *frame = [_stack lastObject];
+    if (!frame) {
+        return NO;
+    }
+    [_stack removeLastObject];
+    [self addValue:frame.container];
+    return YES;
+}
+
+- (void)addValue:(id)value {
+    IFStreamDataFrame *frame = [_stack lastObject];
+    if (!frame) {
+        // Top-level value.
+        _result = value;
+        return;
+    }
+    if (frame.isMap && frame.key == nil) {
+        // Value is a map key.
+        frame.key = [value isKindOfClass:[NSString class]] ? value : [value description];
+        return;
+    }
+    BOOL streamed = NO;
+    if (!frame.streamed && [_streamedPathLengths containsIndex:([frame.path count] + 1)]) {
+        NSArray *path = [self pathForNextValueInFrame:frame];
+        if ([self isStreamedPath:path]) {
+            // Pass the value to the handler instead of adding it to its container.
+            if (_valueHandler) {
+                _valueHandler(path, value);
+            }
+            _streamedValueCount++;
+            streamed = YES;
+        }
+    }
+    if (!streamed) {
+        if (frame.isMap) {
+            ((NSMutableDictionary *)frame.container)[frame.key] = value;
+        }
+        else {
+            [(NSMutableArray *)frame.container addObject:value];
+        }
+    }
+    frame.key = nil;
+    frame.count++;
+    // Check for completion of containers with a known size.
+    if (frame.remaining > 0 && --frame.remaining == 0) {
+        [self endContainer];
+    }
+}
+
+- (NSArray *)pathForNextValueInFrame:(IFStreamDataFrame *)frame {
+    NSString *component = frame.isMap ? frame.key : [NSString stringWithFormat:@"%ld", (long)frame.count];
+    return [frame.path arrayByAddingObject:(component ? component : @"")];
+}
+
+- (BOOL)isStreamedPath:(NSArray *)path {
+    NSInteger length = [path count];
+    for (NSArray *streamedPath in _streamedPathComponents) {
+        if ([streamedPath count] != length) {
+            continue;
+        }
+        BOOL match = YES;
+        for (NSInteger idx = 0; idx < length && match; idx++) {
+            NSString *component = streamedPath[idx];
+            match = [@"*" isEqualToString:component] || [component isEqualToString:path[idx]];
+        }
+        if (match) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (NSError *)makeError:(NSString *)description {
+    return [NSError errorWithDomain:IFStreamDataReaderErrorDomain
+                               code:0
+                           userInfo:@{ NSLocalizedDescriptionKey: description }];
+}
+
++ (IFStreamDataReader *)readerForMIMEType:(NSString *)mimeType {
+    if ([@"application/msgpack" isEqualToString:mimeType]) {
+        return [IFMessagePackStreamReader new];
+    }
+    if ([@"application/json" isEqualToString:mimeType]) {
+        return [IFJSONStreamReader new];
+    }
+    return nil;
+}
+
+@end
+
+#pragma mark - IFMessagePackStreamReader
+
+// Read an unsigned big-endian integer of the specified byte size.
+static uint64_t ReadUInt(const uint8_t *bytes, NSUInteger size) {
+    uint64_t value = 0;
+    for (NSUInteger idx = 0; idx < size; idx++) {
+        value = (value << 8) | bytes[idx];
+    }
+    return value;
+}
+
+@interface IFMessagePackStreamReader ()
+
+/**
+ * Read a value with a sized payload (i.e. a string, binary or extension value).
+ * Returns the number of bytes consumed, or NeedMoreData if the payload is incomplete.
+ */
+- (NSInteger)readPayload:(const uint8_t *)bytes length:(NSUInteger)length header:(NSUInteger)header size:(uint64_t)size type:(uint8_t)type;
+
+@end
+
+@implementation IFMessagePackStreamReader
+
+- (NSInteger)readToken:(const uint8_t *)bytes length:(NSUInteger)length final:(BOOL)final error:(NSError **)error {
+    uint8_t type = bytes[0];
+    // Positive & negative fixints.
+    if (type <= 0x7f) {
+        [self addValue:[NSNumber numberWithInt:type]];
+        return 1;
+    }
+    if (type >= 0xe0) {
+        [self addValue:[NSNumber numberWithInt:(int8_t)type]];
+        return 1;
+    }
+    // Fixmaps, fixarrays & fixstrs.
+    if ((type & 0xf0) == 0x80) {
+        [self beginContainer:YES remaining:(type & 0x0f)];
+        return 1;
+    }
+    if ((type & 0xf0) == 0x90) {
+        [self beginContainer:NO remaining:(type & 0x0f)];
+        return 1;
+    }
+    if ((type & 0xe0) == 0xa0) {
+        return [self readPayload:bytes length:length header:1 size:(type & 0x1f) type:0xd9];
+    }
+    // Sizes of the header for the remaining types, indexed from 0xc0.
+    static const NSUInteger HeaderSizes[] = {
+        1, 1, 1, 1,     // nil, (unused), false, true
+        2, 3, 5,        // bin 8/16/32
+        3, 4, 6,        // ext 8/16/32
+        5, 9,           // float 32/64
+        2, 3, 5, 9,     // uint 8/16/32/64
+        2, 3, 5, 9,     // int 8/16/32/64
+        2, 2, 2, 2, 2,  // fixext 1/2/4/8/16
+        2, 3, 5,        // str 8/16/32
+        3, 5,           // array 16/32
+        3, 5            // map 16/32
+    };
+    NSUInteger header = HeaderSizes[type - 0xc0];
+    if (length < header) {
+        return NeedMoreData;
+    }
+    const uint8_t *p = bytes + 1;
+    switch (type) {
+        case 0xc0:
+            [self addValue:[NSNull null]];
+            return 1;
+        case 0xc2:
+            [self addValue:@NO];
+            return 1;
+        case 0xc3:
+            [self addValue:@YES];
+            return 1;
+        case 0xc4: case 0xc5: case 0xc6:
+            return [self readPayload:bytes length:length header:header size:ReadUInt(p, header - 1) type:type];
+        case 0xc7: case 0xc8: case 0xc9:
+            // Extension types; the size is followed by a type byte, which is included in the header.
+            return [self readPayload:bytes length:length header:header size:ReadUInt(p, header - 2) type:type];
+        case 0xca: {
+            uint32_t bits = (uint32_t)ReadUInt(p, 4);
+            float value;
+            memcpy(&value, &bits, sizeof(value));
+            [self addValue:[NSNumber numberWithFloat:value]];
+            return header;
+        }
+        case 0xcb: {
+            uint64_t bits = ReadUInt(p, 8);
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            [self addValue:[NSNumber numberWithDouble:value]];
+            return header;
+        }
+        case 0xcc: case 0xcd: case 0xce: case 0xcf:
+            [self addValue:[NSNumber numberWithUnsignedLongLong:ReadUInt(p, header - 1)]];
+            return header;
+        case 0xd0:
+            [self addValue:[NSNumber numberWithLongLong:(int8_t)ReadUInt(p, 1)]];
+            return header;
+        case 0xd1:
+            [self addValue:[NSNumber numberWithLongLong:(int16_t)ReadUInt(p, 2)]];
+            return header;
+        case 0xd2:
+            [self addValue:[NSNumber numberWithLongLong:(int32_t)ReadUInt(p, 4)]];
+            return header;
+        case 0xd3:
+            [self addValue:[NSNumber numberWithLongLong:(int64_t)ReadUInt(p, 8)]];
+            return header;
+        case 0xd4: case 0xd5: case 0xd6: case 0xd7: case 0xd8:
+            return [self readPayload:bytes length:length header:header size:(1 << (type - 0xd4)) type:type];
+        case 0xd9: case 0xda: case 0xdb:
+            return [self readPayload:bytes length:length header:header size:ReadUInt(p, header - 1) type:0xd9];
+        case 0xdc: case 0xdd:
+            [self beginContainer:NO remaining:(NSInteger)ReadUInt(p, header - 1)];
+            return header;
+        case 0xde: case 0xdf:
+            [self beginContainer:YES remaining:(NSInteger)ReadUInt(p, header - 1)];
+            return header;
+        default:
+            if (error) {
+                *error = [self makeError:[NSString stringWithFormat:@"Invalid msgpack type 0x%02x", type]];
+            }
+            return ReadError;
+    }
+}
+
+- (NSInteger)readPayload:(const uint8_t *)bytes length:(NSUInteger)length header:(NSUInteger)header size:(uint64_t)size type:(uint8_t)type {
+    if (length < header + size) {
+        return NeedMoreData;
+    }
+    id value;
+    if (type == 0xd9) {
+        value = [[NSString alloc] initWithBytes:(bytes + header) length:(NSUInteger)size encoding:NSUTF8StringEncoding];
+        if (!value) {
+            value = [NSNull null];
+        }
+    }
+    else {
+        // Binary & extension values are returned as raw data.
+        value = [NSData dataWithBytes:(bytes + header) length:(NSUInteger)size];
+    }
+    [self addValue:value];
+    return (NSInteger)(header + size);
+}
+
+@end
+
+#pragma mark - IFJSONStreamReader
+
+@interface IFJSONStreamReader ()
+
+/// Read a string token. Returns the number of bytes consumed, or NeedMoreData.
+- (NSInteger)readString:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError **)error;
+/// Read a number token. Returns the number of bytes consumed, or NeedMoreData.
+- (NSInteger)readNumber:(const uint8_t *)bytes length:(NSUInteger)length final:(BOOL)final;
+/// Read a literal token. Returns the number of bytes consumed, or NeedMoreData.
+- (NSInteger)readLiteral:(NSString *)literal value:(id)value bytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError **)error;
+
+@end
+
+// Append a unicode code point to a buffer of UTF-8 encoded data.
+static void AppendUTF8(NSMutableData *data, uint32_t cp) {
+    uint8_t utf8[4];
+    NSUInteger size;
+    if (cp < 0x80) {
+        utf8[0] = cp;
+        size = 1;
+    }
+    else if (cp < 0x800) {
+        utf8[0] = 0xc0 | (cp >> 6);
+        utf8[1] = 0x80 | (cp & 0x3f);
+        size = 2;
+    }
+    else if (cp < 0x10000) {
+        utf8[0] = 0xe0 | (cp >> 12);
+        utf8[1] = 0x80 | ((cp >> 6) & 0x3f);
+        utf8[2] = 0x80 | (cp & 0x3f);
+        size = 3;
+    }
+    else {
+        utf8[0] = 0xf0 | (cp >> 18);
+        utf8[1] = 0x80 | ((cp >> 12) & 0x3f);
+        utf8[2] = 0x80 | ((cp >> 6) & 0x3f);
+        utf8[3] = 0x80 | (cp & 0x3f);
+        size = 4;
+    }
+    [data appendBytes:utf8 length:size];
+}
+
+// Read four hex digits as a UTF-16 code unit; returns -1 if the digits are invalid.
+static int32_t ReadHex4(const uint8_t *bytes) {
+    int32_t value = 0;
+    for (NSInteger idx = 0; idx < 4; idx++) {
+        uint8_t ch = bytes[idx];
+        value <<= 4;
+        if (ch >= '0' && ch <= '9')         value |= (ch - '0');
+        else if (ch >= 'a' && ch <= 'f')    value |= (ch - 'a' + 10);
+        else if (ch >= 'A' && ch <= 'F')    value |= (ch - 'A' + 10);
+        else return -1;
+    }
+    return value;
+}
+
+@implementation IFJSONStreamReader
+
+- (NSInteger)readToken:(const uint8_t *)bytes length:(NSUInteger)length final:(BOOL)final error:(NSError **)error {
+    switch (bytes[0]) {
+        case ' ': case '\t': case '\r': case '\n': {
+            NSUInteger idx = 1;
+            while (idx < length && (bytes[idx] == ' ' || bytes[idx] == '\t' || bytes[idx] == '\r' || bytes[idx] == '\n')) {
+                idx++;
+            }
+            return idx;
+        }
+        case '{':
+            [self beginContainer:YES remaining:-1];
+            return 1;
+        case '[':
+            [self beginContainer:NO remaining:-1];
+            return 1;
+        case '}': case ']':
+            if (![self endContainer]) {
+                break;
+            }
+            return 1;
+        case ',': case ':':
+            // Separators carry no information needed by the reader.
+            return 1;
+        case '"':
+            return [self readString:bytes length:length error:error];
+        case 't':
+            return [self readLiteral:@"true" value:@YES bytes:bytes length:length error:error];
+        case 'f':
+            return [self readLiteral:@"false" value:@NO bytes:bytes length:length error:error];
+        case 'n':
+            return [self readLiteral:@"null" value:[NSNull null] bytes:bytes length:length error:error];
+        case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+            return [self readNumber:bytes length:length final:final];
+        default:
+            break;
+    }
+    if (error) {
+        *error = [self makeError:[NSString stringWithFormat:@"Unexpected character '%c' in JSON", bytes[0]]];
+    }
+    return ReadError;
+}
+
+- (NSInteger)readString:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError **)error {
+    // Find the closing quote.
+    NSUInteger end = 1;
+    BOOL escaped = NO;
+    while (end < length && bytes[end] != '"') {
+        if (bytes[end] == '\\') {
+            escaped = YES;
+            end++;
+        }
+        end++;
+    }
+    if (end >= length) {
+        return NeedMoreData;
+    }
+    NSString *value;
+    if (!escaped) {
+        value = [[NSString alloc] initWithBytes:(bytes + 1) length:(end - 1) encoding:NSUTF8StringEncoding];
+    }
+    else {
+        NSMutableData *data = [[NSMutableData alloc] initWithCapacity:end];
+        for (NSUInteger idx = 1; idx < end; idx++) {
+            uint8_t ch = bytes[idx];
+            if (ch != '\\') {
+                [data appendBytes:&ch length:1];
+                continue;
+            }
+            ch = bytes[++idx];
+            switch (ch) {
+                case 'b': ch = '\b'; break;
+                case 'f': ch = '\f'; break;
+                case 'n': ch = '\n'; break;
+                case 'r': ch = '\r'; break;
+                case 't': ch = '\t'; break;
+                case 'u': {
+                    // Unicode escape; check for surrogate pairs.
+                    int32_t cp = (idx + 4 < end) ? ReadHex4(bytes + idx + 1) : -1;
+                    if (cp < 0) {
+                        if (error) {
+                            *error = [self makeError:@"Invalid unicode escape in JSON string"];
+                        }
+                        return ReadError;
+                    }
+                    idx += 4;
+                    if (cp >= 0xd800 && cp <= 0xdbff && idx + 6 < end && bytes[idx + 1] == '\\' && bytes[idx + 2] == 'u') {
+                        int32_t low = ReadHex4(bytes + idx + 3);
+                        if (low >= 0xdc00 && low <= 0xdfff) {
+                            cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+                            idx += 6;
+                        }
+                    }
+                    AppendUTF8(data, (uint32_t)cp);
+                    continue;
+                }
+                default:
+                    // Includes \" \\ and \/
+                    break;
+            }
+            [data appendBytes:&ch length:1];
+        }
+        value = [[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding];
+    }
+    [self addValue:(value ? value : (id)[NSNull null])];
+    return end + 1;
+}
+
+- (NSInteger)readNumber:(const uint8_t *)bytes length:(NSUInteger)length final:(BOOL)final {
+    NSUInteger end = 0;
+    BOOL isFloat = NO;
+    while (end < length) {
+        uint8_t ch = bytes[end];
+        if (ch == '.' || ch == 'e' || ch == 'E') {
+            isFloat = YES;
+        }
+        else if (!((ch >= '0' && ch <= '9') || ch == '-' || ch == '+')) {
+            break;
+        }
+        end++;
+    }
+    // A number running to the end of the buffer may continue in the next append.
+    if (end == length && !final) {
+        return NeedMoreData;
+    }
+    char number[64];
+    NSUInteger size = MIN(end, sizeof(number) - 1);
+    memcpy(number, bytes, size);
+    number[size] = '\0';
+    if (isFloat) {
+        [self addValue:[NSNumber numberWithDouble:strtod(number, NULL)]];
+    }
+    else {
+        [self addValue:[NSNumber numberWithLongLong:strtoll(number, NULL, 10)]];
+    }
+    return end;
+}
+
+- (NSInteger)readLiteral:(NSString *)literal value:(id)value bytes:(const uint8_t *)bytes length:(NSUInteger)length error:(NSError **)error {
+    const char *chars = [literal UTF8String];
+    NSUInteger size = strlen(chars);
+    NSUInteger compare = MIN(size, length);
+    if (memcmp(bytes, chars, compare) != 0) {
+        if (error) {
+            *error = [self makeError:@"Invalid literal in JSON"];
+        }
+        return ReadError;
+    }
+    if (length < size) {
+        return NeedMoreData;
+    }
+    [self addValue:value];
+    return size;
+}
+
+@end
@@ -0,0 +1,55 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/**
+ * A parallel zip archive extractor.
+ * Reads the archive's central directory, creates all of the archive's directories up front, and then
+ * partitions the archive's file entries across a pool of workers which inflate and write entries
+ * concurrently. The archive file is memory mapped, so workers read entry data directly without
+ * contending for a shared file handle.
+ * Supports stored and deflated entries and zip64 archives; encrypted entries aren't supported.
+ * Entry CRCs are verified as each entry is written.
+ */
+@interface IFZipExtractor : NSObject
+
+/// Initialize an extractor for the zip archive at the specified path.
+- (id _Nonnull)initWithArchivePath:(NSString * _Nonnull)archivePath;
+
+/// The path of the archive file.
+@property (nonatomic, strong, readonly) NSString * _Nonnull archivePath;
+/// The number of workers used to extract entries. Defaults to the number of active processor cores.
+@property (nonatomic, assign) NSUInteger concurrency;
+
+/**
+ * Extract the archive's entries into a directory.
+ * @param path      The directory to extract entries into.
+ * @param overwrite If NO then entries for files which already exist are skipped.
+ * @param error     Set to the first error which occurred, if extraction fails.
+ * Returns YES if all entries were extracted.
+ */
+- (BOOL)extractToPath:(NSString * _Nonnull)path overwrite:(BOOL)overwrite error:(NSError * _Nullable * _Nullable)error;
+
+/// Extract a zip archive into a directory using a default extractor.
++ (BOOL)extractArchiveAtPath:(NSString * _Nonnull)archivePath
+                      toPath:(NSString * _Nonnull)path
+                   overwrite:(BOOL)overwrite
+                       error:(NSError * _Nullable * _Nullable)error;
+
+@end
@@ -0,0 +1,347 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import "IFZipExtractor.h"
+#import <zlib.h>
+
+#define LocalFileHeaderSignature            (0x04034b50)
+#define CentralDirectorySignature           (0x02014b50)
+#define EndOfCentralDirectorySignature      (0x06054b50)
+#define Zip64EndOfCentralDirectorySignature (0x06064b50)
+#define Zip64EndOfCentralDirectoryLocatorSignature (0x07064b50)
+#define LocalFileHeaderSize                 (30)
+#define CentralDirectoryHeaderSize          (46)
+#define EndOfCentralDirectorySize           (22)
+#define Zip64EndOfCentralDirectoryLocatorSize (20)
+#define MaxCommentSize                      (0xFFFF)
+#define Zip64ExtraFieldID                   (0x0001)
+#define FlagEncrypted                       (0x0001)
+#define FlagUTF8                            (0x0800)
+#define MethodStored                        (0)
+#define MethodDeflated                      (8)
+#define WriteBufferSize                     (64 * 1024)
+/// The maximum number of bytes passed to zlib in one call; zlib lengths are 32 bit, entries may be larger.
+#define MaxZlibChunkSize                    ((uint64_t)UINT_MAX)
+
+static uint16_t readUInt16(const uint8_t *bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t readUInt32(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint64_t readUInt64(const uint8_t *bytes) {
+    return (uint64_t)readUInt32(bytes) | ((uint64_t)readUInt32(bytes + 4) << 32);
+}
+
+static NSError *makeZipError(NSString *description) {
+    return [NSError errorWithDomain:NSCocoaErrorDomain
+                               code:NSFileReadCorruptFileError
+                           userInfo:@{ NSLocalizedDescriptionKey: description }];
+}
+
+/// A file entry read from an archive's central directory.
+@interface IFZipExtractorEntry : NSObject
+
+@property (nonatomic, strong) NSString *name;
+@property (nonatomic, assign) uint16_t method;
+@property (nonatomic, assign) uint32_t crc;
+@property (nonatomic, assign) uint64_t compressedSize;
+@property (nonatomic, assign) uint64_t uncompressedSize;
+@property (nonatomic, assign) uint64_t localHeaderOffset;
+
+@end
+
+@interface IFZipExtractor ()
+
+/// Read the archive's central directory. Returns a list of entries, or nil if the directory can't be read.
+- (NSArray *)readEntriesFromData:(NSData *)data error:(NSError **)error;
+/// Extract a single file entry.
+- (BOOL)extractEntry:(IFZipExtractorEntry *)entry
+            fromData:(NSData *)data
+              toPath:(NSString *)path
+               error:(NSError **)error;
+
+@end
+
+@implementation IFZipExtractorEntry
+
+@end
+
+@implementation IFZipExtractor
+
+- (id)initWithArchivePath:(NSString *)archivePath {
+    self = [super init];
+    if (self) {
+        _archivePath = archivePath;
+        _concurrency = [[NSProcessInfo processInfo] activeProcessorCount];
+    }
+    return self;
+}
+
+// TODO: Benchmark against the serial IFFileIO unzip over a 5,000-file image pack, and test zip64
+// entries and duplicate entry names; the pod has no test or benchmark target for these yet.
+- (BOOL)extractToPath:(NSString *)path overwrite:(BOOL)overwrite error:(NSError **)error {
+    NSError *readError = nil;
+    NSData *data = [NSData dataWithContentsOfFile:_archivePath options:NSDataReadingMappedIfSafe error:&readError];
+    NSArray *entries = data ? [self readEntriesFromData:data error:&readError] : nil;
+    if (!entries) {
+        if (error) {
+            *error = readError;
+        }
+        return NO;
+    }
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    // Create all directories before extracting any files, so that workers don't race to create the
+    // same directory; each distinct directory is only created once.
+    NSMutableOrderedSet *dirPaths = [NSMutableOrderedSet orderedSetWithObject:path];
+    // Files are keyed by name; an archive may contain several entries with the same name, in which
+    // case only the last is extracted (as by a serial unzip), so that no two workers write the same file.
+    NSMutableDictionary *filesByName = [NSMutableDictionary new];
+    for (IFZipExtractorEntry *entry in entries) {
+        NSString *entryPath = [path stringByAppendingPathComponent:entry.name];
+        if ([entry.name hasSuffix:@"/"]) {
+            [dirPaths addObject:entryPath];
+        }
+        else {
+            [dirPaths addObject:[entryPath stringByDeletingLastPathComponent]];
+            if (overwrite || ![fileManager fileExistsAtPath:entryPath]) {
+                filesByName[entry.name] = entry;
+            }
+        }
+    }
+    NSMutableArray *files = [[filesByName allValues] mutableCopy];
+    for (NSString *dirPath in dirPaths) {
+        [fileManager createDirectoryAtPath:dirPath withIntermediateDirectories:YES attributes:nil error:nil];
+    }
+    // Partition the files across the workers. Files are sorted by size and dealt out in turn, so
+    // that each worker receives a similar share of the work.
+    [files sortUsingComparator:^NSComparisonResult(IFZipExtractorEntry *e1, IFZipExtractorEntry *e2) {
+        if (e1.uncompressedSize == e2.uncompressedSize) {
+            return NSOrderedSame;
+        }
+        return e1.uncompressedSize > e2.uncompressedSize ? NSOrderedAscending : NSOrderedDescending;
+    }];
+    NSUInteger workers = MAX(1, MIN(_concurrency, [files count]));
+    __block NSError *firstError = nil;
+    NSObject *errorLock = [NSObject new];
+    dispatch_apply(workers, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t worker) {
+        for (NSUInteger i = worker; i < [files count]; i += workers) {
+            @autoreleasepool {
+                NSError *entryError = nil;
+                if (![self extractEntry:files[i] fromData:data toPath:path error:&entryError]) {
+                    @synchronized (errorLock) {
+                        if (!firstError) {
+                            firstError = entryError;
+                        }
+                    }
+                    return;
+                }
+            }
+            // Stop early once any worker has failed.
+            @synchronized (errorLock) {
+                if (firstError) {
+                    return;
+                }
+            }
+        }
+    });
+    if (firstError && error) {
+        *error = firstError;
+    }
+    return firstError == nil;
+}
+
++ (BOOL)extractArchiveAtPath:(NSString *)archivePath toPath:(NSString *)path overwrite:(BOOL)overwrite error:(NSError **)error {
+    IFZipExtractor *extractor = [[IFZipExtractor alloc] initWithArchivePath:archivePath];
+    return [extractor extractToPath:path overwrite:overwrite error:error];
+}
+
+#pragma mark - Private methods
+
+- (NSArray *)readEntriesFromData:(NSData *)data error:(NSError **)error {
+    const uint8_t *bytes = (const uint8_t *)[data bytes];
+    NSUInteger length = [data length];
+    // Find the end of central directory record, searching backwards over any archive comment.
+    if (length < EndOfCentralDirectorySize) {
+        *error = makeZipError(@"Invalid zip archive");
+        return nil;
+    }
+    NSInteger eocdOffset = -1;
+    NSUInteger searchLimit = length > (EndOfCentralDirectorySize + MaxCommentSize) ? length - (EndOfCentralDirectorySize + MaxCommentSize) : 0;
+    for (NSUInteger i = length - EndOfCentralDirectorySize; ; i--) {
+        if (readUInt32(bytes + i) == EndOfCentralDirectorySignature) {
+            eocdOffset = (NSInteger)i;
+            break;
+        }
+        if (i == searchLimit) {
+            break;
+        }
+    }
+    if (eocdOffset < 0) {
+        *error = makeZipError(@"Zip central directory not found");
+        return nil;
+    }
+    uint64_t entryCount = readUInt16(bytes + eocdOffset + 10);
+    uint64_t directoryOffset = readUInt32(bytes + eocdOffset + 16);
+    // Check for a zip64 end of central directory record.
+    NSInteger locatorOffset = eocdOffset - Zip64EndOfCentralDirectoryLocatorSize;
+    if (locatorOffset >= 0 && readUInt32(bytes + locatorOffset) == Zip64EndOfCentralDirectoryLocatorSignature) {
+        uint64_t zip64Offset = readUInt64(bytes + locatorOffset + 8);
+        if (zip64Offset + 56 <= length && readUInt32(bytes + zip64Offset) == Zip64EndOfCentralDirectorySignature) {
+            entryCount = readUInt64(bytes + zip64Offset + 32);
+            directoryOffset = readUInt64(bytes + zip64Offset + 48);
+        }
+    }
+    NSMutableArray *entries = [NSMutableArray new];
+    uint64_t offset = directoryOffset;
+    for (uint64_t n = 0; n < entryCount; n++) {
+        if (offset + CentralDirectoryHeaderSize > length || readUInt32(bytes + offset) != CentralDirectorySignature) {
+            *error = makeZipError(@"Invalid zip central directory");
+            return nil;
+        }
+        const uint8_t *header = bytes + offset;
+        uint16_t flags = readUInt16(header + 8);
+        uint16_t nameLength = readUInt16(header + 28);
+        uint16_t extraLength = readUInt16(header + 30);
+        uint16_t commentLength = readUInt16(header + 32);
+        if (offset + CentralDirectoryHeaderSize + nameLength + extraLength > length) {
+            *error = makeZipError(@"Invalid zip central directory");
+            return nil;
+        }
+        IFZipExtractorEntry *entry = [IFZipExtractorEntry new];
+        NSStringEncoding encoding = (flags & FlagUTF8) ? NSUTF8StringEncoding : NSISOLatin1StringEncoding;
+        entry.name = [[NSString alloc] initWithBytes:header + CentralDirectoryHeaderSize length:nameLength encoding:encoding];
+        entry.method = readUInt16(header + 10);
+        entry.crc = readUInt32(header + 16);
+        entry.compressedSize = readUInt32(header + 20);
+        entry.uncompressedSize = readUInt32(header + 24);
+        entry.localHeaderOffset = readUInt32(header + 42);
+        // Read zip64 values from the extra field; only values which overflow the header fields are present.
+        const uint8_t *extra = header + CentralDirectoryHeaderSize + nameLength;
+        for (NSUInteger i = 0; i + 4 <= extraLength; ) {
+            uint16_t fieldID = readUInt16(extra + i);
+            uint16_t fieldSize = readUInt16(extra + i + 2);
+            if (fieldID == Zip64ExtraFieldID && i + 4 + fieldSize <= extraLength) {
+                const uint8_t *value = extra + i + 4;
+                const uint8_t *end = value + fieldSize;
+                if (entry.uncompressedSize == 0xFFFFFFFF && value + 8 <= end) {
+                    entry.uncompressedSize = readUInt64(value);
+                    value += 8;
+                }
+                if (entry.compressedSize == 0xFFFFFFFF && value + 8 <= end) {
+                    entry.compressedSize = readUInt64(value);
+                    value += 8;
+                }
+                if (entry.localHeaderOffset == 0xFFFFFFFF && value + 8 <= end) {
+                    entry.localHeaderOffset = readUInt64(value);
+                }
+            }
+            i += 4 + fieldSize;
+        }
+        // Reject entry names which would extract outside of the target directory.
+        if (!entry.name || [entry.name isAbsolutePath] || [[entry.name pathComponents] containsObject:@".."]) {
+            *error = makeZipError([NSString stringWithFormat:@"Invalid zip entry name: %@", entry.name]);
+            return nil;
+        }
+        if (flags & FlagEncrypted) {
+            *error = makeZipError([NSString stringWithFormat:@"Encrypted zip entry not supported: %@", entry.name]);
+            return nil;
+        }
+        [entries addObject:entry];
+        offset += CentralDirectoryHeaderSize + nameLength + extraLength + commentLength;
+    }
+    return entries;
+}
+
+- (BOOL)extractEntry:(IFZipExtractorEntry *)entry fromData:(NSData *)data toPath:(NSString *)path error:(NSError **)error {
+    const uint8_t *bytes = (const uint8_t *)[data bytes];
+    NSUInteger length = [data length];
+    // Locate the entry's data, following its local header; note that the local header's extra
+    // field may differ in length from the central directory's.
+    uint64_t headerOffset = entry.localHeaderOffset;
+    if (headerOffset + LocalFileHeaderSize > length || readUInt32(bytes + headerOffset) != LocalFileHeaderSignature) {
+        *error = makeZipError([NSString stringWithFormat:@"Invalid local header for zip entry: %@", entry.name]);
+        return NO;
+    }
+    uint64_t dataOffset = headerOffset + LocalFileHeaderSize + readUInt16(bytes + headerOffset + 26) + readUInt16(bytes + headerOffset + 28);
+    if (dataOffset + entry.compressedSize > length) {
+        *error = makeZipError([NSString stringWithFormat:@"Truncated zip entry: %@", entry.name]);
+        return NO;
+    }
+    if (entry.method != MethodStored && entry.method != MethodDeflated) {
+        *error = makeZipError([NSString stringWithFormat:@"Unsupported compression method for zip entry: %@", entry.name]);
+        return NO;
+    }
+    NSString *entryPath = [path stringByAppendingPathComponent:entry.name];
+    FILE *file = fopen([entryPath fileSystemRepresentation], "wb");
+    if (!file) {
+        *error = makeZipError([NSString stringWithFormat:@"Unable to create file for zip entry: %@", entry.name]);
+        return NO;
+    }
+    const uint8_t *input = bytes + dataOffset;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    BOOL ok = YES;
+    if (entry.method == MethodStored) {
+        for (uint64_t offset = 0; ok && offset < entry.compressedSize; offset += MaxZlibChunkSize) {
+            uInt chunkSize = (uInt)MIN(MaxZlibChunkSize, entry.compressedSize - offset);
+            crc = crc32(crc, input + offset, chunkSize);
+            ok = fwrite(input + offset, 1, chunkSize, file) == chunkSize;
+        }
+    }
+    else {
+        z_stream zstream;
+        memset(&zstream, 0, sizeof(zstream));
+        // Negative window bits indicates raw deflate data, i.e. without a zlib header.
+        ok = inflateInit2(&zstream, -MAX_WBITS) == Z_OK;
+        uint8_t output[WriteBufferSize];
+        // The compressed data is passed to zlib in chunks, as zlib's input length is 32 bit.
+        uint64_t remaining = entry.compressedSize;
+        zstream.next_in = (Bytef *)input;
+        int status = Z_OK;
+        while (ok && status != Z_STREAM_END) {
+            if (zstream.avail_in == 0 && remaining > 0) {
+                zstream.avail_in = (uInt)MIN(MaxZlibChunkSize, remaining);
+                remaining -= zstream.avail_in;
+            }
+            zstream.next_out = output;
+            zstream.avail_out = WriteBufferSize;
+            status = inflate(&zstream, Z_NO_FLUSH);
+            if (status != Z_OK && status != Z_STREAM_END) {
+                ok = NO;
+                break;
+            }
+            size_t produced = WriteBufferSize - zstream.avail_out;
+            crc = crc32(crc, output, (uInt)produced);
+            ok = fwrite(output, 1, produced, file) == produced;
+        }
+        inflateEnd(&zstream);
+    }
+    fclose(file);
+    if (ok && (uint32_t)crc != entry.crc) {
+        ok = NO;
+    }
+    if (!ok) {
+        [[NSFileManager defaultManager] removeItemAtPath:entryPath error:nil];
+        *error = makeZipError([NSString stringWithFormat:@"Failed to extract zip entry: %@", entry.name]);
+    }
+    return ok;
+}
+
+@end
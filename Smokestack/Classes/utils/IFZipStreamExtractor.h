@@ -0,0 +1,55 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "IFHTTPClient.h"
+
+/**
+ * A streaming zip archive extractor.
+ * Extracts the entries of a zip archive as the archive's bytes arrive, e.g. as a zip file is
+ * downloaded, by reading each entry's local file header and inflating its data directly into the
+ * target directory. This avoids writing the archive to a temporary file and then reading it back
+ * in a second pass. The archive's central directory is ignored.
+ * Supports stored and deflated entries, including entries with trailing data descriptors; encrypted
+ * entries aren't supported. Entry CRCs are verified as each entry completes.
+ * As a data receiver, only the body of a 200 response is extracted.
+ */
+@interface IFZipStreamExtractor : NSObject <IFHTTPClientDataReceiver>
+
+/// Initialize an extractor which extracts entries into the directory at the specified path.
+- (id _Nonnull)initWithPath:(NSString * _Nonnull)path;
+
+/// The path of the directory entries are extracted to.
+@property (nonatomic, strong, readonly) NSString * _Nonnull path;
+/// Any error which occurred during extraction; no further data is extracted after an error.
+@property (nonatomic, strong, readonly) NSError * _Nullable error;
+/// The number of entries extracted.
+@property (nonatomic, assign, readonly) NSUInteger entryCount;
+/// Whether the archive's data was received and extracted; NO if the response wasn't a 200.
+@property (nonatomic, assign, readonly) BOOL extracted;
+
+/// Append archive data to the extractor.
+- (void)appendData:(NSData * _Nonnull)data;
+/**
+ * Finish extracting.
+ * Should be called once all data has been received. Returns NO if an error occurred, or if the
+ * archive is incomplete.
+ */
+- (BOOL)finish:(NSError * _Nullable * _Nullable)error;
+
+@end
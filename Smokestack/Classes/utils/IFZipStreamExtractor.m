@@ -0,0 +1,393 @@
+// Copyright 2016 InnerFunction Ltd.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+//  Created by Julian Goacher on 19/10/2026.
+//  Copyright © 2026 InnerFunction. All rights reserved.
+//
+
+#import "IFZipStreamExtractor.h"
+#import <zlib.h>
+
+#define LocalFileHeaderSignature        (0x04034b50)
+#define DataDescriptorSignature         (0x08074b50)
+#define CentralDirectorySignature       (0x02014b50)
+#define EndOfCentralDirectorySignature  (0x06054b50)
+#define LocalFileHeaderSize             (30)
+#define Zip64ExtraFieldID               (0x0001)
+#define FlagEncrypted                   (0x0001)
+#define FlagDataDescriptor              (0x0008)
+#define FlagUTF8                        (0x0800)
+#define MethodStored                    (0)
+#define MethodDeflated                  (8)
+#define InflateBufferSize               (32 * 1024)
+
+typedef NS_ENUM(NSInteger, IFZipStreamState) {
+    IFZipStreamStateHeader,
+    IFZipStreamStateEntryData,
+    IFZipStreamStateDataDescriptor,
+    IFZipStreamStateDone
+};
+
+static uint16_t readUInt16(const uint8_t *bytes) {
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t readUInt32(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static uint64_t readUInt64(const uint8_t *bytes) {
+    return (uint64_t)readUInt32(bytes) | ((uint64_t)readUInt32(bytes + 4) << 32);
+}
+
+@interface IFZipStreamExtractor () {
+    /// Received data not yet consumed.
+    NSMutableData *_buffer;
+    /// The offset of the first unconsumed byte in the buffer.
+    NSUInteger _offset;
+    /// The current parse state.
+    IFZipStreamState _state;
+    /// Directories already created during extraction.
+    NSMutableSet *_createdDirectories;
+    /// The current entry's name.
+    NSString *_entryName;
+    /// A handle for writing the current entry's file; nil for directory entries.
+    NSFileHandle *_entryFile;
+    /// The current entry's flags and compression method.
+    uint16_t _entryFlags;
+    uint16_t _entryMethod;
+    /// Whether the current entry uses zip64 sizes.
+    BOOL _entryZip64;
+    /// The CRC recorded in the current entry's header.
+    uint32_t _entryCRC;
+    /// The CRC of the entry data written so far.
+    uLong _computedCRC;
+    /// The number of compressed bytes of the current entry still to be read, when known.
+    uint64_t _entryRemaining;
+    /// The inflate stream for the current entry.
+    z_stream _zstream;
+    /// Whether the inflate stream is initialized.
+    BOOL _inflating;
+}
+
+/// Read a local file header. Returns YES if the header was read.
+- (BOOL)readHeader;
+/// Read entry data. Returns YES if the end of the entry's data was reached.
+- (BOOL)readEntryData;
+/// Read a data descriptor. Returns YES if the descriptor was read.
+- (BOOL)readDataDescriptor;
+/// Start extracting an entry.
+- (BOOL)beginEntry:(NSString *)name;
+/// Write decoded entry data to the entry's file.
+- (void)writeEntryBytes:(const uint8_t *)bytes length:(NSUInteger)length;
+/// End the current entry's data.
+- (BOOL)endEntryData;
+/// Verify an entry's CRC and complete the entry.
+- (BOOL)completeEntryWithCRC:(uint32_t)crc;
+/// Record an error and release any entry resources.
+- (void)failWithDescription:(NSString *)description;
+/// Release the current entry's resources.
+- (void)closeEntry;
+
+@end
+
+@implementation IFZipStreamExtractor
+
+- (id)initWithPath:(NSString *)path {
+    self = [super init];
+    if (self) {
+        _path = path;
+        _buffer = [NSMutableData new];
+        _state = IFZipStreamStateHeader;
+        _createdDirectories = [NSMutableSet new];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [self closeEntry];
+}
+
+- (void)appendData:(NSData *)data {
+    if (_error || _state == IFZipStreamStateDone) {
+        return;
+    }
+    if (!_extracted) {
+        _extracted = YES;
+        [[NSFileManager defaultManager] createDirectoryAtPath:_path withIntermediateDirectories:YES attributes:nil error:nil];
+    }
+    [_buffer appendData:data];
+    BOOL progress = YES;
+    while (progress && !_error && _state != IFZipStreamStateDone) {
+        switch (_state) {
+            case IFZipStreamStateHeader:
+                progress = [self readHeader];
+                break;
+            case IFZipStreamStateEntryData:
+                progress = [self readEntryData];
+                break;
+            case IFZipStreamStateDataDescriptor:
+                progress = [self readDataDescriptor];
+                break;
+            default:
+                progress = NO;
+        }
+    }
+    // Discard consumed data.
+    if (_offset > 0) {
+        [_buffer replaceBytesInRange:NSMakeRange(0, _offset) withBytes:NULL length:0];
+        _offset = 0;
+    }
+}
+
+- (BOOL)finish:(NSError **)error {
+    if (!_error && _extracted && _state != IFZipStreamStateDone) {
+        [self failWithDescription:@"Incomplete zip archive"];
+    }
+    if (_error && error) {
+        *error = _error;
+    }
+    return _error == nil;
+}
+
+#pragma mark - IFHTTPClientDataReceiver
+
+- (void)receiveResponse:(NSHTTPURLResponse *)response {
+    if (response.statusCode != 200) {
+        // Not an archive; ignore the response body.
+        _state = IFZipStreamStateDone;
+    }
+}
+
+- (void)receiveData:(NSData *)data {
+    [self appendData:data];
+}
+
+#pragma mark - Private methods
+
+- (BOOL)readHeader {
+    NSUInteger available = [_buffer length] - _offset;
+    if (available < 4) {
+        return NO;
+    }
+    const uint8_t *bytes = (const uint8_t *)[_buffer bytes] + _offset;
+    uint32_t signature = readUInt32(bytes);
+    if (signature == CentralDirectorySignature || signature == EndOfCentralDirectorySignature) {
+        // All entries have been read.
+        _state = IFZipStreamStateDone;
+        return NO;
+    }
+    if (signature != LocalFileHeaderSignature) {
+        [self failWithDescription:@"Invalid zip entry header"];
+        return NO;
+    }
+    if (available < LocalFileHeaderSize) {
+        return NO;
+    }
+    uint16_t nameLength = readUInt16(bytes + 26);
+    uint16_t extraLength = readUInt16(bytes + 28);
+    NSUInteger headerSize = LocalFileHeaderSize + nameLength + extraLength;
+    if (available < headerSize) {
+        return NO;
+    }
+    _entryFlags = readUInt16(bytes + 6);
+    _entryMethod = readUInt16(bytes + 8);
+    _entryCRC = readUInt32(bytes + 14);
+    uint64_t compressedSize = readUInt32(bytes + 18);
+    uint64_t uncompressedSize = readUInt32(bytes + 22);
+    // Read zip64 sizes from the extra field, if present.
+    _entryZip64 = NO;
+    const uint8_t *extra = bytes + LocalFileHeaderSize + nameLength;
+    for (NSUInteger i = 0; i + 4 <= extraLength; ) {
+        uint16_t fieldID = readUInt16(extra + i);
+        uint16_t fieldSize = readUInt16(extra + i + 2);
+        if (fieldID == Zip64ExtraFieldID && fieldSize >= 16 && i + 4 + fieldSize <= extraLength) {
+            _entryZip64 = YES;
+            uncompressedSize = readUInt64(extra + i + 4);
+            compressedSize = readUInt64(extra + i + 12);
+        }
+        i += 4 + fieldSize;
+    }
+    NSStringEncoding encoding = (_entryFlags & FlagUTF8) ? NSUTF8StringEncoding : NSISOLatin1StringEncoding;
+    NSString *name = [[NSString alloc] initWithBytes:bytes + LocalFileHeaderSize length:nameLength encoding:encoding];
+    _offset += headerSize;
+    if (_entryFlags & FlagEncrypted) {
+        [self failWithDescription:[NSString stringWithFormat:@"Encrypted zip entry not supported: %@", name]];
+        return NO;
+    }
+    if (_entryMethod != MethodStored && _entryMethod != MethodDeflated) {
+        [self failWithDescription:[NSString stringWithFormat:@"Unsupported compression method for zip entry: %@", name]];
+        return NO;
+    }
+    if (_entryMethod == MethodStored && (_entryFlags & FlagDataDescriptor)) {
+        // The size of a stored entry with a data descriptor can't be known until its data has been read.
+        [self failWithDescription:[NSString stringWithFormat:@"Unsized stored zip entry not supported: %@", name]];
+        return NO;
+    }
+    _entryRemaining = (_entryFlags & FlagDataDescriptor) ? UINT64_MAX : compressedSize;
+    if (![self beginEntry:name]) {
+        return NO;
+    }
+    _state = IFZipStreamStateEntryData;
+    return YES;
+}
+
+- (BOOL)readEntryData {
+    if (_entryRemaining == 0) {
+        return [self endEntryData];
+    }
+    NSUInteger available = [_buffer length] - _offset;
+    if (available == 0) {
+        return NO;
+    }
+    const uint8_t *bytes = (const uint8_t *)[_buffer bytes] + _offset;
+    NSUInteger length = (NSUInteger)MIN((uint64_t)available, _entryRemaining);
+    if (_entryMethod == MethodStored) {
+        [self writeEntryBytes:bytes length:length];
+        _offset += length;
+        _entryRemaining -= length;
+        return _entryRemaining == 0 ? [self endEntryData] : NO;
+    }
+    uint8_t output[InflateBufferSize];
+    _zstream.next_in = (Bytef *)bytes;
+    _zstream.avail_in = (uInt)MIN(length, (NSUInteger)UINT_MAX);
+    uInt inputLength = _zstream.avail_in;
+    int status;
+    do {
+        _zstream.next_out = output;
+        _zstream.avail_out = InflateBufferSize;
+        status = inflate(&_zstream, Z_NO_FLUSH);
+        if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+            [self failWithDescription:[NSString stringWithFormat:@"Invalid compressed data in zip entry: %@", _entryName]];
+            return NO;
+        }
+        [self writeEntryBytes:output length:InflateBufferSize - _zstream.avail_out];
+    }
+    while (status == Z_OK && (_zstream.avail_in > 0 || _zstream.avail_out == 0));
+    NSUInteger consumed = inputLength - _zstream.avail_in;
+    _offset += consumed;
+    if (!(_entryFlags & FlagDataDescriptor)) {
+        _entryRemaining -= consumed;
+    }
+    if (status == Z_STREAM_END) {
+        if (!(_entryFlags & FlagDataDescriptor) && _entryRemaining > 0) {
+            [self failWithDescription:[NSString stringWithFormat:@"Invalid compressed size for zip entry: %@", _entryName]];
+            return NO;
+        }
+        return [self endEntryData];
+    }
+    if (!(_entryFlags & FlagDataDescriptor) && _entryRemaining == 0) {
+        [self failWithDescription:[NSString stringWithFormat:@"Truncated compressed data in zip entry: %@", _entryName]];
+    }
+    return NO;
+}
+
+- (BOOL)readDataDescriptor {
+    NSUInteger available = [_buffer length] - _offset;
+    if (available < 4) {
+        return NO;
+    }
+    const uint8_t *bytes = (const uint8_t *)[_buffer bytes] + _offset;
+    // The descriptor signature is optional.
+    NSUInteger signatureSize = readUInt32(bytes) == DataDescriptorSignature ? 4 : 0;
+    NSUInteger descriptorSize = signatureSize + (_entryZip64 ? 20 : 12);
+    if (available < descriptorSize) {
+        return NO;
+    }
+    uint32_t crc = readUInt32(bytes + signatureSize);
+    _offset += descriptorSize;
+    return [self completeEntryWithCRC:crc];
+}
+
+- (BOOL)beginEntry:(NSString *)name {
+    // Reject entry names which would extract outside of the target directory.
+    NSArray *components = [name pathComponents];
+    if (!name || [name isAbsolutePath] || [components containsObject:@".."]) {
+        [self failWithDescription:[NSString stringWithFormat:@"Invalid zip entry name: %@", name]];
+        return NO;
+    }
+    _entryName = name;
+    _computedCRC = crc32(0L, Z_NULL, 0);
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSString *entryPath = [_path stringByAppendingPathComponent:name];
+    BOOL isDirectory = [name hasSuffix:@"/"];
+    NSString *dirPath = isDirectory ? entryPath : [entryPath stringByDeletingLastPathComponent];
+    if (![_createdDirectories containsObject:dirPath]) {
+        [fileManager createDirectoryAtPath:dirPath withIntermediateDirectories:YES attributes:nil error:nil];
+        [_createdDirectories addObject:dirPath];
+    }
+    if (!isDirectory) {
+        // Note that any existing file is replaced.
+        if (![fileManager createFileAtPath:entryPath contents:nil attributes:nil]) {
+            [self failWithDescription:[NSString stringWithFormat:@"Unable to create file for zip entry: %@", name]];
+            return NO;
+        }
+        _entryFile = [NSFileHandle fileHandleForWritingAtPath:entryPath];
+    }
+    if (_entryMethod == MethodDeflated) {
+        memset(&_zstream, 0, sizeof(_zstream));
+        // Negative window bits indicates raw deflate data, i.e. without a zlib header.
+        if (inflateInit2(&_zstream, -MAX_WBITS) != Z_OK) {
+            [self failWithDescription:@"Unable to initialize inflate stream"];
+            return NO;
+        }
+        _inflating = YES;
+    }
+    return YES;
+}
+
+- (void)writeEntryBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    if (length == 0) {
+        return;
+    }
+    _computedCRC = crc32(_computedCRC, bytes, (uInt)length);
+    [_entryFile writeData:[NSData dataWithBytes:bytes length:length]];
+}
+
+- (BOOL)endEntryData {
+    if (_entryFlags & FlagDataDescriptor) {
+        _state = IFZipStreamStateDataDescriptor;
+        return YES;
+    }
+    return [self completeEntryWithCRC:_entryCRC];
+}
+
+- (BOOL)completeEntryWithCRC:(uint32_t)crc {
+    [self closeEntry];
+    if ((uint32_t)_computedCRC != crc) {
+        [self failWithDescription:[NSString stringWithFormat:@"CRC mismatch for zip entry: %@", _entryName]];
+        return NO;
+    }
+    _entryCount++;
+    _state = IFZipStreamStateHeader;
+    return YES;
+}
+
+- (void)failWithDescription:(NSString *)description {
+    [self closeEntry];
+    _error = [NSError errorWithDomain:NSCocoaErrorDomain
+                                 code:NSFileReadCorruptFileError
+                             userInfo:@{ NSLocalizedDescriptionKey: description }];
+}
+
+- (void)closeEntry {
+    [_entryFile closeFile];
+    _entryFile = nil;
+    if (_inflating) {
+        inflateEnd(&_zstream);
+        _inflating = NO;
+    }
+}
+
+@end